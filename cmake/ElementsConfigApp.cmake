@@ -58,7 +58,11 @@ set(ELEMENTS_RESOURCES
    ${ELEMENTS_ROOT}/resources/fonts/Roboto-Bold.ttf
 )
 
-if (UNIX AND NOT APPLE)
+# Set ELEMENTS_APP_EMBED_RESOURCES to link the resources into the app (see
+# ElementsResourceBundle.cmake) instead of copying them next to it.
+include(${ELEMENTS_ROOT}/cmake/ElementsResourceBundle.cmake)
+
+if (UNIX AND NOT APPLE AND NOT ELEMENTS_APP_EMBED_RESOURCES)
    file(
       COPY ${ELEMENTS_RESOURCES} ${ELEMENTS_APP_RESOURCES}
       DESTINATION "${CMAKE_CURRENT_BINARY_DIR}/resources"
@@ -66,7 +70,7 @@ if (UNIX AND NOT APPLE)
 
 endif()
 
-if (WIN32)
+if (WIN32 AND NOT ELEMENTS_APP_EMBED_RESOURCES)
    file(
       COPY ${ELEMENTS_RESOURCES} ${ELEMENTS_APP_RESOURCES}
       DESTINATION "${CMAKE_CURRENT_BINARY_DIR}/resources"
@@ -147,6 +151,12 @@ target_compile_options(${ELEMENTS_APP_PROJECT} PRIVATE
     $<$<CXX_COMPILER_ID:MSVC>:/utf-8>
 )
 
+if (ELEMENTS_APP_EMBED_RESOURCES)
+   elements_add_resource_bundle(${ELEMENTS_APP_PROJECT}
+      FILES ${ELEMENTS_RESOURCES} ${ELEMENTS_APP_RESOURCES}
+   )
+endif()
+
 ###############################################################################
 # Libraries and linking
 
@@ -0,0 +1,133 @@
+###############################################################################
+#  Copyright (c) 2016-2020 Joel de Guzman
+#
+#  Distributed under the MIT License (https://opensource.org/licenses/MIT)
+###############################################################################
+
+###############################################################################
+# elements_add_resource_bundle(<target>
+#    [DIRECTORY <dir>]
+#    [FILES <file>...]
+# )
+#
+# Packs resources into a single read-only bundle (see
+# elements/support/resource_bundle.hpp) that is compiled and linked into
+# <target> and mounted at startup. Files in DIRECTORY are named by their
+# path relative to it (e.g. "images/knob.png"). FILES are named by their
+# file name, the same way they are copied into the resources directory.
+#
+# The bundle is generated at configure time. Changing any of the bundled
+# files triggers a reconfigure.
+###############################################################################
+
+# Little endian hex digits of value, bytes wide
+function(_elements_le_hex value bytes out)
+   math(EXPR hex "${value}" OUTPUT_FORMAT HEXADECIMAL)
+   string(SUBSTRING "${hex}" 2 -1 hex)
+   string(LENGTH "${hex}" len)
+   math(EXPR pad "${bytes} * 2 - ${len}")
+   if (pad GREATER 0)
+      string(REPEAT "0" ${pad} zeros)
+      set(hex "${zeros}${hex}")
+   endif()
+   set(result "")
+   math(EXPR last "${bytes} - 1")
+   foreach(i RANGE ${last})
+      math(EXPR pos "(${bytes} - 1 - ${i}) * 2")
+      string(SUBSTRING "${hex}" ${pos} 2 byte)
+      string(APPEND result "${byte}")
+   endforeach()
+   set(${out} "${result}" PARENT_SCOPE)
+endfunction()
+
+function(elements_add_resource_bundle target)
+   if (CMAKE_VERSION VERSION_LESS 3.15)
+      message(FATAL_ERROR "elements_add_resource_bundle requires CMake 3.15 or newer.")
+   endif()
+
+   cmake_parse_arguments(BUNDLE "" "DIRECTORY" "FILES" ${ARGN})
+
+   # Collect name;path pairs
+   set(names "")
+   if (BUNDLE_DIRECTORY)
+      file(GLOB_RECURSE dir_files RELATIVE ${BUNDLE_DIRECTORY} ${BUNDLE_DIRECTORY}/*)
+      foreach(name ${dir_files})
+         list(APPEND names ${name})
+         set(path_${name} ${BUNDLE_DIRECTORY}/${name})
+      endforeach()
+   endif()
+   foreach(path ${BUNDLE_FILES})
+      get_filename_component(name ${path} NAME)
+      list(APPEND names ${name})
+      set(path_${name} ${path})
+   endforeach()
+   list(REMOVE_DUPLICATES names)
+   list(SORT names)   # The entries are binary searched by name
+   list(LENGTH names num_entries)
+
+   # Layout: header (16 bytes), entries (24 bytes each), names, then the
+   # data of each resource, 16 byte aligned.
+   set(work_dir ${CMAKE_CURRENT_BINARY_DIR}/${target}_resources)
+   file(MAKE_DIRECTORY ${work_dir})
+
+   math(EXPR offset "16 + ${num_entries} * 24")
+   set(name_hex "")
+   foreach(name ${names})
+      file(WRITE ${work_dir}/name ${name})
+      file(READ ${work_dir}/name hex HEX)
+      string(LENGTH ${name} size)
+      set(name_offset_${name} ${offset})
+      set(name_size_${name} ${size})
+      string(APPEND name_hex ${hex})
+      math(EXPR offset "${offset} + ${size}")
+   endforeach()
+
+   set(data_hex "")
+   set(configure_depends "")
+   foreach(name ${names})
+      math(EXPR pad "(16 - ${offset} % 16) % 16")
+      if (pad GREATER 0)
+         string(REPEAT "00" ${pad} zeros)
+         string(APPEND data_hex ${zeros})
+         math(EXPR offset "${offset} + ${pad}")
+      endif()
+      file(READ ${path_${name}} hex HEX)
+      file(SIZE ${path_${name}} size)
+      set(data_offset_${name} ${offset})
+      set(data_size_${name} ${size})
+      string(APPEND data_hex "${hex}")
+      math(EXPR offset "${offset} + ${size}")
+      list(APPEND configure_depends ${path_${name}})
+   endforeach()
+
+   # "ERBX", version 1, num_entries, reserved
+   _elements_le_hex(1 4 version_hex)
+   _elements_le_hex(${num_entries} 4 count_hex)
+   set(blob_hex "45524258${version_hex}${count_hex}00000000")
+   foreach(name ${names})
+      _elements_le_hex(${name_offset_${name}} 4 a)
+      _elements_le_hex(${name_size_${name}} 4 b)
+      _elements_le_hex(${data_offset_${name}} 8 c)
+      _elements_le_hex(${data_size_${name}} 8 d)
+      string(APPEND blob_hex "${a}${b}${c}${d}")
+   endforeach()
+   string(APPEND blob_hex "${name_hex}${data_hex}")
+
+   string(REGEX REPLACE "([0-9a-fA-F][0-9a-fA-F])" "0x\\1," blob "${blob_hex}")
+   set(source ${work_dir}/resource_bundle.cpp)
+   file(WRITE ${source}.tmp
+"// Generated by elements_add_resource_bundle. Do not edit.
+#include <elements/support/resource_bundle.hpp>
+
+namespace
+{
+   alignas(16) unsigned char const bundle[] = { ${blob} };
+
+   bool const mounted = cycfi::elements::mount_resource_bundle(bundle, sizeof(bundle));
+}
+")
+   configure_file(${source}.tmp ${source} COPYONLY)
+
+   target_sources(${target} PRIVATE ${source})
+   set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${configure_depends})
+endfunction()
@@ -25,6 +25,17 @@ namespace cycfi { namespace elements
       cairo_surface_t* surface = nullptr;
       GtkWidget* widget = nullptr;
 
+      // Live resize: while the window is being resized, the last full frame
+      // is presented stretched to the new size. Full layout and drawing runs
+      // at a capped rate, and once more when resizing stops.
+      point surface_size;
+      bool surface_drawn = false;
+      cairo_surface_t* resize_frame = nullptr;
+      point resize_frame_size;
+      gint64 last_full_draw = 0;
+      guint resize_settle_timer = 0;
+      guint resize_draw_timer = 0;
+
       // Mouse button click tracking
       std::uint32_t click_time = 0;
       std::uint32_t click_count = 0;
@@ -59,6 +70,12 @@ namespace cycfi { namespace elements
 
    host_view::~host_view()
    {
+      if (resize_settle_timer)
+         g_source_remove(resize_settle_timer);
+      if (resize_draw_timer)
+         g_source_remove(resize_draw_timer);
+      if (resize_frame)
+         cairo_surface_destroy(resize_frame);
       if (surface)
          cairo_surface_destroy(surface);
       surface = nullptr;
@@ -75,19 +92,103 @@ namespace cycfi { namespace elements
          return *reinterpret_cast<base_view*>(user_data);
       }
 
+      constexpr guint resize_settle_ms = 150;            // Resizing stopped
+      constexpr gint64 resize_draw_interval_us = 50000;  // Full draws while resizing
+
+      gboolean on_resize_settled(gpointer user_data)
+      {
+         auto& view = get(user_data);
+         auto* host_view_h = platform_access::get_host_view(view);
+         host_view_h->resize_settle_timer = 0;
+         view.end_live_resize();
+         if (host_view_h->resize_frame)
+         {
+            cairo_surface_destroy(host_view_h->resize_frame);
+            host_view_h->resize_frame = nullptr;
+         }
+         gtk_widget_queue_draw(host_view_h->widget);
+         return G_SOURCE_REMOVE;
+      }
+
+      gboolean on_resize_draw(gpointer user_data)
+      {
+         auto& view = get(user_data);
+         auto* host_view_h = platform_access::get_host_view(view);
+         host_view_h->resize_draw_timer = 0;
+         gtk_widget_queue_draw(host_view_h->widget);
+         return G_SOURCE_REMOVE;
+      }
+
       gboolean on_configure(GtkWidget* widget, GdkEventConfigure* /* event */, gpointer user_data)
       {
          auto& view = get(user_data);
          auto* host_view_h = platform_access::get_host_view(view);
+         auto width = gtk_widget_get_allocated_width(widget);
+         auto height = gtk_widget_get_allocated_height(widget);
 
          if (host_view_h->surface)
-            cairo_surface_destroy(host_view_h->surface);
+         {
+            if (width == host_view_h->surface_size.x && height == host_view_h->surface_size.y)
+               return true;
+
+            // Keep the last full frame for presenting while resizing
+            if (host_view_h->surface_drawn)
+            {
+               if (host_view_h->resize_frame)
+                  cairo_surface_destroy(host_view_h->resize_frame);
+               host_view_h->resize_frame = host_view_h->surface;
+               host_view_h->resize_frame_size = host_view_h->surface_size;
+            }
+            else
+            {
+               cairo_surface_destroy(host_view_h->surface);
+            }
+
+            if (host_view_h->resize_settle_timer)
+               g_source_remove(host_view_h->resize_settle_timer);
+            else
+               view.begin_live_resize();
+            host_view_h->resize_settle_timer =
+               g_timeout_add(resize_settle_ms, on_resize_settled, user_data);
+         }
 
          host_view_h->surface = gdk_window_create_similar_surface(
             gtk_widget_get_window(widget), CAIRO_CONTENT_COLOR,
-            gtk_widget_get_allocated_width(widget),
-            gtk_widget_get_allocated_height(widget)
+            width, height
          );
+         host_view_h->surface_size = { float(width), float(height) };
+         host_view_h->surface_drawn = false;
+         return true;
+      }
+
+      // While resizing, present the last full frame stretched to the current
+      // size, unless a (rate capped) full draw is due. Returns true if the
+      // frame was presented.
+      bool draw_resize_frame(host_view* host_view_h, cairo_t* cr, gpointer user_data)
+      {
+         if (!host_view_h->resize_frame)
+            return false;
+
+         auto elapsed = g_get_monotonic_time() - host_view_h->last_full_draw;
+         if (elapsed >= resize_draw_interval_us)
+            return false;
+
+         // Make sure the full draw happens when it is due
+         if (!host_view_h->resize_draw_timer)
+         {
+            auto remaining_ms = guint((resize_draw_interval_us - elapsed) / 1000) + 1;
+            host_view_h->resize_draw_timer =
+               g_timeout_add(remaining_ms, on_resize_draw, user_data);
+         }
+
+         auto from = host_view_h->resize_frame_size;
+         auto to = host_view_h->surface_size;
+         cairo_save(cr);
+         cairo_scale(cr, to.x / from.x, to.y / from.y);
+         cairo_set_source_surface(cr, host_view_h->resize_frame, 0, 0);
+         cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
+         cairo_paint(cr);
+         cairo_restore(cr);
          return true;
       }
 
@@ -95,18 +196,34 @@ namespace cycfi { namespace elements
       {
          auto& view = get(user_data);
          auto* host_view_h = platform_access::get_host_view(view);
-         cairo_set_source_surface(cr, host_view_h->surface, 0, 0);
-         cairo_paint(cr);
+
+         if (draw_resize_frame(host_view_h, cr, user_data))
+            return false;
 
          // Note that cr (cairo_t) is already clipped to only draw the
          // exposed areas of the widget.
          double left, top, right, bottom;
          cairo_clip_extents(cr, &left, &top, &right, &bottom);
+
+         // Draw into the backing store, then present it. The backing store
+         // is kept as the last full frame for live resizing.
+         auto store = cairo_create(host_view_h->surface);
+         cairo_rectangle(store, left, top, right-left, bottom-top);
+         cairo_clip(store);
+         cairo_set_operator(store, CAIRO_OPERATOR_CLEAR);
+         cairo_paint(store);
+         cairo_set_operator(store, CAIRO_OPERATOR_OVER);
          view.draw(
-            cr,
+            store,
             rect{ float(left), float(top), float(right), float(bottom) }
          );
+         cairo_destroy(store);
+
+         cairo_set_source_surface(cr, host_view_h->surface, 0, 0);
+         cairo_paint(cr);
 
+         host_view_h->surface_drawn = true;
+         host_view_h->last_full_draw = g_get_monotonic_time();
          return false;
       }
 
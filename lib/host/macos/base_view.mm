@@ -502,6 +502,18 @@ namespace
 {
 }
 
+- (void) viewWillStartLiveResize
+{
+   [super viewWillStartLiveResize];
+   _view->begin_live_resize();
+}
+
+- (void) viewDidEndLiveResize
+{
+   [super viewDidEndLiveResize];
+   _view->end_live_resize();
+}
+
 -(void) windowDidBecomeKey : (NSNotification*) notification
 {
    _view->begin_focus();
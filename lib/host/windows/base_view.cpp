@@ -465,6 +465,15 @@ namespace cycfi { namespace elements
                info->vptr->end_focus();
                break;
 
+            // Forwarded by the parent window
+            case WM_ENTERSIZEMOVE:
+               info->vptr->begin_live_resize();
+               break;
+
+            case WM_EXITSIZEMOVE:
+               info->vptr->end_live_resize();
+               break;
+
             default:
                return DefWindowProcW(hwnd, message, wparam, lparam);
          }
@@ -127,6 +127,19 @@ namespace cycfi { namespace elements
             case WM_DPICHANGED:
             case WM_SIZE: return on_size(hwnd);
 
+            case WM_ENTERSIZEMOVE:
+            case WM_EXITSIZEMOVE:
+               // Let the views know about live resizing
+               EnumChildWindows(hwnd,
+                  [](HWND child, LPARAM msg) -> BOOL
+                  {
+                     SendMessageW(child, UINT(msg), 0, 0);
+                     return true;
+                  },
+                  message
+               );
+               break;
+
             case WM_SIZING:
                if (info)
                {
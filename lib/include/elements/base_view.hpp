@@ -312,6 +312,8 @@ namespace cycfi { namespace elements
       virtual void      text(text_info const& /* info */) {}
       virtual void      begin_focus() {}
       virtual void      end_focus() {}
+      virtual void      begin_live_resize() {}
+      virtual void      end_live_resize() {}
       virtual void      poll() {}
 
       virtual void      refresh();
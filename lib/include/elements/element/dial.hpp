@@ -79,6 +79,7 @@ namespace cycfi { namespace elements
 
       color                   _color;
       float                   _value;
+      static_layer            _layer;
    };
 
    template <std::size_t size>
@@ -89,6 +90,7 @@ namespace cycfi { namespace elements
    }
 
    void draw_indicator(canvas& cnv, circle cp, float val, color c);
+   void draw_knob(canvas& cnv, static_layer& layer, circle cp, color c);
 
    template <std::size_t size>
    inline void basic_knob_element<size>::draw(context const& ctx)
@@ -98,7 +100,7 @@ namespace cycfi { namespace elements
       auto  indicator_color = thm.indicator_color.level(1.5);
       auto  cp = circle{ center_point(ctx.bounds), ctx.bounds.width()/2 };
 
-      draw_knob(cnv, cp, _color);
+      draw_knob(cnv, _layer, cp, _color);
       draw_indicator(cnv, cp, _value, indicator_color);
    }
 
@@ -183,9 +185,15 @@ namespace cycfi { namespace elements
       using base_type::base_type;
 
       void                    draw(context const& ctx) override;
+
+   private:
+
+      static_layer            _layer;
    };
 
    void draw_radial_marks(canvas& cnv, circle cp, float size, color c);
+   void draw_radial_marks(
+      canvas& cnv, static_layer& layer, circle cp, float size, color c);
 
    template <std::size_t size, typename Subject>
    inline void
@@ -196,7 +204,7 @@ namespace cycfi { namespace elements
 
       // Draw radial lines
       auto cp = circle{ center_point(ctx.bounds), ctx.bounds.width()/2 };
-      draw_radial_marks(ctx.canvas, cp, size-2, colors::light_gray);
+      draw_radial_marks(ctx.canvas, _layer, cp, size-2, colors::light_gray);
    }
 
    template <std::size_t size, typename Subject>
@@ -227,6 +235,10 @@ namespace cycfi { namespace elements
 
       string_array            _labels;
       float                   _font_size;
+
+   private:
+
+      static_layer            _layer;
    };
 
    void draw_radial_labels(
@@ -238,6 +250,16 @@ namespace cycfi { namespace elements
     , std::size_t _num_labels
    );
 
+   void draw_radial_labels(
+      canvas& cnv
+    , static_layer& layer
+    , circle cp
+    , float size
+    , float font_size
+    , std::string const labels[]
+    , std::size_t _num_labels
+   );
+
    template <std::size_t size, typename Subject, std::size_t num_labels>
    inline void
    radial_labels_element<size, Subject, num_labels>::draw(context const& ctx)
@@ -248,7 +270,7 @@ namespace cycfi { namespace elements
       // Draw the labels
       auto cp = circle{ center_point(ctx.bounds), ctx.bounds.width()/2 };
       draw_radial_labels(
-         ctx.canvas, cp, size, _font_size, _labels.data(), num_labels);
+         ctx.canvas, _layer, cp, size, _font_size, _labels.data(), num_labels);
    }
 
    template <std::size_t size, typename Subject, typename... S>
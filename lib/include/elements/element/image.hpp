@@ -9,12 +9,21 @@
 #include <elements/element/element.hpp>
 #include <elements/support/canvas.hpp>
 #include <elements/support/pixmap.hpp>
+#include <elements/support/filmstrip.hpp>
+#include <elements/support/static_layer.hpp>
 #include <memory>
 
 namespace cycfi { namespace elements
 {
    ////////////////////////////////////////////////////////////////////////////
    // Images
+   //
+   // tint draws the image multiplied by a color. recolor draws it filled
+   // with a color, keeping only its alpha (e.g. for monochrome icons and
+   // glyphs). The colored pixmaps are looked up at draw time, from the
+   // cache kept with the source pixmap (see pixmap::tinted and
+   // pixmap::recolored), and shared by all images using it with the same
+   // color.
    ////////////////////////////////////////////////////////////////////////////
    class image : public element
    {
@@ -27,15 +36,60 @@ namespace cycfi { namespace elements
       void                    draw(context const& ctx) override;
       virtual rect            source_rect(context const& ctx) const;
 
+      void                    tint(color c);
+      void                    recolor(color c);
+      void                    clear_tint();
+
    protected:
 
-      elements::pixmap&       pixmap() const  { return *_pixmap.get(); }
+      enum color_mode { no_color, tint_color, recolor_color };
+
+      elements::pixmap const& pixmap() const  { return *_pixmap; }
+      pixmap_ptr              colored(elements::pixmap const& pm) const;
+      pixmap_ptr              colored_pixmap() const;
+
+      color_mode              _color_mode = no_color;
+      color                   _color;
 
    private:
 
       pixmap_ptr              _pixmap;
    };
 
+   ////////////////////////////////////////////////////////////////////////////
+   // Asynchronously loaded images. The file is decoded on a worker thread,
+   // starting at construction time. Until it is ready, a placeholder filled
+   // with the given color is drawn. The image has fixed limits (size, in
+   // view coordinates), supplied up front, and the decoded pixmap is scaled
+   // to fit. When the pixmap is ready, only the element's area is refreshed.
+   // If loading fails, the placeholder stays.
+   ////////////////////////////////////////////////////////////////////////////
+   class async_image : public element
+   {
+   public:
+                              async_image(
+                                 char const* filename, extent size
+                               , float scale = 1
+                               , color placeholder = colors::black.opacity(0.1)
+                              );
+                              ~async_image();
+
+      view_limits             limits(basic_context const& ctx) const override;
+      void                    draw(context const& ctx) override;
+
+      bool                    is_ready() const;
+      pixmap_ptr              get_pixmap() const;
+
+   private:
+
+      struct state;
+      using state_ptr = std::shared_ptr<state>;
+
+      state_ptr               _state;
+      extent                  _size;
+      color                   _placeholder;
+   };
+
    ////////////////////////////////////////////////////////////////////////////
 	// Elements uses gizmos for user interface images such as buttons, frames etc.
    // Basically a gizmo is a resizeable image. The unique feature is its ability
@@ -63,6 +117,9 @@ namespace cycfi { namespace elements
    // Variants of the gizmo are the hgizmo and vgizmo both having 3 patches
    // allowing resizing in one dimension (horozontally or vertically) only.
    //
+   // The patches are composed once in a static_layer and redrawn as a single
+   // blit until the gizmo's size or the device scale changes.
+   //
    ////////////////////////////////////////////////////////////////////////////
    class gizmo : public image
    {
@@ -72,6 +129,10 @@ namespace cycfi { namespace elements
 
       view_limits             limits(basic_context const& ctx) const override;
       void                    draw(context const& ctx) override;
+
+   private:
+
+      static_layer            _layer;
    };
 
    class hgizmo : public image
@@ -82,6 +143,10 @@ namespace cycfi { namespace elements
 
       view_limits             limits(basic_context const& ctx) const override;
       void                    draw(context const& ctx) override;
+
+   private:
+
+      static_layer            _layer;
    };
 
    class vgizmo : public image
@@ -92,6 +157,10 @@ namespace cycfi { namespace elements
 
       view_limits             limits(basic_context const& ctx) const override;
       void                    draw(context const& ctx) override;
+
+   private:
+
+      static_layer            _layer;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -123,12 +192,25 @@ namespace cycfi { namespace elements
       double                  value() const override;
    };
 
+   // Pass compressed_frames to the sprite's constructor to keep its frames
+   // in a compressed_filmstrip (see filmstrip.hpp), decoding only the frame
+   // shown (and its neighbours, ahead of time, on a worker thread). Tinted
+   // or recolored frames are colored as they are decoded. This trades a
+   // bit of CPU for a lot less memory with large filmstrips.
+   struct compressed_frames_tag {};
+   constexpr compressed_frames_tag compressed_frames = {};
+
    class basic_sprite : public image
    {
    public:
                               basic_sprite(char const* filename, float height, float scale = 1);
+                              basic_sprite(
+                                 char const* filename, float height, float scale
+                               , compressed_frames_tag
+                              );
 
       view_limits             limits(basic_context const& ctx) const override;
+      void                    draw(context const& ctx) override;
 
       std::size_t             num_frames() const;
       std::size_t             index() const              { return _index; }
@@ -139,8 +221,14 @@ namespace cycfi { namespace elements
 
    private:
 
+      using frames_ptr = std::shared_ptr<compressed_filmstrip>;
+
+      float                   width() const;
+
       size_t                  _index;
+      size_t                  _prefetched = -1;
       float                   _height;
+      frames_ptr              _frames;
    };
 
    struct sprite : basic_sprite, sprite_as_int<sprite>, sprite_as_double<sprite>
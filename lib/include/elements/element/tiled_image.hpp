@@ -0,0 +1,162 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_TILED_IMAGE_OCTOBER_18_2020)
+#define ELEMENTS_TILED_IMAGE_OCTOBER_18_2020
+
+#include <elements/element/element.hpp>
+#include <elements/support/color.hpp>
+#include <elements/support/pixmap.hpp>
+#include <infra/filesystem.hpp>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace cycfi { namespace elements
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Tiled multi-resolution images (image pyramids). Level 0 is the image
+   // at full resolution. Each level above it is half the size of the one
+   // below (rounded up), down to num_levels-1. Every level is cut into
+   // square tiles, tile_size pixels wide, starting at the top-left. Tiles
+   // at the right and bottom edges may be smaller.
+   ////////////////////////////////////////////////////////////////////////////
+   struct tile_key
+   {
+      int               level;
+      int               col;
+      int               row;
+   };
+
+   inline bool operator<(tile_key const& a, tile_key const& b)
+   {
+      if (a.level != b.level)
+         return a.level < b.level;
+      if (a.row != b.row)
+         return a.row < b.row;
+      return a.col < b.col;
+   }
+
+   inline bool operator==(tile_key const& a, tile_key const& b)
+   {
+      return a.level == b.level && a.col == b.col && a.row == b.row;
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // tile_source: Provides the tiles of a pyramid. load is called from
+   // worker threads, possibly concurrently, and returns the tile, or a
+   // nullptr if there is none. If num_levels is 0, the pyramid goes all
+   // the way down to a single tile.
+   ////////////////////////////////////////////////////////////////////////////
+   class tile_source
+   {
+   public:
+                              tile_source(extent size, int tile_size = 256, int num_levels = 0);
+      virtual                 ~tile_source() = default;
+
+      extent                  size() const         { return _size; }
+      int                     tile_size() const    { return _tile_size; }
+      int                     num_levels() const   { return _num_levels; }
+
+      extent                  level_size(int level) const;
+      int                     num_cols(int level) const;
+      int                     num_rows(int level) const;
+
+      virtual pixmap_ptr      load(tile_key key) = 0;
+
+   private:
+
+      extent                  _size;
+      int                     _tile_size;
+      int                     _num_levels;
+   };
+
+   using tile_source_ptr = std::shared_ptr<tile_source>;
+
+   // Tiles stored as files, one directory per level: <path>/<level>/<col>_<row>.<ext>
+   class directory_tile_source : public tile_source
+   {
+   public:
+                              directory_tile_source(
+                                 fs::path path, extent size
+                               , int tile_size = 256, int num_levels = 0
+                               , std::string ext = "png"
+                              );
+
+      pixmap_ptr              load(tile_key key) override;
+
+   private:
+
+      fs::path                _path;
+      std::string             _ext;
+   };
+
+   // Tiles generated (or fetched) by a function
+   class callback_tile_source : public tile_source
+   {
+   public:
+
+      using load_function = std::function<pixmap_ptr(tile_key key)>;
+
+                              callback_tile_source(
+                                 load_function load, extent size
+                               , int tile_size = 256, int num_levels = 0
+                              );
+
+      pixmap_ptr              load(tile_key key) override;
+
+   private:
+
+      load_function           _load;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // tiled_image: Displays a tile_source, one source pixel per view unit
+   // times scale. Only the tiles intersecting the visible part of the
+   // element (e.g. the port of a scroller) are drawn, from the level that
+   // best matches the current zoom (the canvas transform, including the
+   // view's scale). Missing tiles are loaded on worker threads, and are
+   // drawn from a coarser cached level (or with the placeholder color)
+   // until then. Tiles no longer visible by the time a worker gets to them
+   // are skipped.
+   //
+   // Loaded tiles are kept in an LRU cache, up to cache_budget bytes of
+   // pixels.
+   ////////////////////////////////////////////////////////////////////////////
+   class tiled_image : public element
+   {
+   public:
+                              tiled_image(
+                                 tile_source_ptr source
+                               , float scale = 1
+                               , color placeholder = colors::black.opacity(0.1)
+                               , std::size_t cache_budget = 64 * 1024 * 1024
+                              );
+                              ~tiled_image();
+
+      view_limits             limits(basic_context const& ctx) const override;
+      void                    draw(context const& ctx) override;
+
+      tile_source const&      source() const       { return *_source; }
+      std::size_t             cache_size() const;
+      void                    clear_cache();
+
+   private:
+
+      struct state;
+      using state_ptr = std::shared_ptr<state>;
+
+      int                     select_level(context const& ctx) const;
+      bool                    draw_tile(context const& ctx, tile_key key, rect dest);
+
+      tile_source_ptr         _source;
+      float                   _scale;
+      color                   _placeholder;
+      state_ptr               _state;
+   };
+}}
+
+#endif
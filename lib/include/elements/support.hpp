@@ -12,12 +12,17 @@
 #include <elements/support/circle.hpp>
 #include <elements/support/color.hpp>
 #include <elements/support/context.hpp>
+#include <elements/support/display_list.hpp>
+#include <elements/support/filmstrip.hpp>
 #include <elements/support/font.hpp>
 #include <elements/support/glyphs.hpp>
 #include <elements/support/icon_ids.hpp>
+#include <elements/support/pixel_ops.hpp>
 #include <elements/support/pixmap.hpp>
 #include <elements/support/point.hpp>
 #include <elements/support/rect.hpp>
+#include <elements/support/resource_bundle.hpp>
+#include <elements/support/static_layer.hpp>
 #include <elements/support/draw_utils.hpp>
 #include <elements/support/text_utils.hpp>
 #include <elements/support/theme.hpp>
@@ -14,14 +14,14 @@
 #include <infra/filesystem.hpp>
 
 #include <vector>
-#include <functional>
-#include <stack>
+#include <array>
 #include <cmath>
 #include <cassert>
 
 extern "C"
 {
    typedef struct _cairo cairo_t;
+   typedef struct _cairo_pattern cairo_pattern_t;
 }
 
 namespace cycfi { namespace elements
@@ -57,6 +57,7 @@ namespace cycfi { namespace elements
       void              clip();
       bool              hit_test(point p) const;
       elements::rect    fill_extent() const;
+      elements::rect    clip_extent() const;
 
       void              move_to(point p);
       void              line_to(point p);
@@ -186,28 +187,97 @@ namespace cycfi { namespace elements
       void              save();
       void              restore();
 
+      ///////////////////////////////////////////////////////////////////////////////////
+      // Quality
+
+      // Reduced quality trades fidelity for speed while the user interacts
+      // (e.g. dragging). It switches to fast antialiasing and unhinted text.
+      // Drawing utilities may also skip expensive effects such as shadows.
+      void              reduced_quality(bool reduce);
+      bool              reduced_quality() const       { return _reduced_quality; }
+
    private:
 
       friend class glyphs;
 
       void              apply_fill_style();
       void              apply_stroke_style();
+      bool              fill_pixel_rect(elements::rect r, color c);
+      bool              update_pixel_clip();
+
+      // A fill or stroke style: nothing, a solid color, or a (referenced)
+      // cairo pattern with its pattern matrix. Copying a style does not
+      // allocate.
+      class style
+      {
+      public:
+                              style() = default;
+                              style(color c);
+                              style(cairo_pattern_t* pattern, cairo_matrix_t const& mat); // adopts pattern
+                              style(style const& rhs);
+                              style(style&& rhs) noexcept;
+                              ~style();
+
+         style&               operator=(style const& rhs);
+         style&               operator=(style&& rhs) noexcept;
+         explicit             operator bool() const   { return _kind != none; }
+         color const*         solid_color() const     { return _kind == color_kind ? &_color : nullptr; }
+
+         void                 apply(cairo_t& context_) const;
+         void                 update_matrix() const;
+
+      private:
+
+         enum kind_enum { none, color_kind, pattern_kind };
+
+         kind_enum            _kind = none;
+         color                _color;
+         cairo_pattern_t*     _pattern = nullptr;
+         cairo_matrix_t       _matrix;
+      };
 
       struct canvas_state
       {
-         std::function<void()>   stroke_style;
-         std::function<void()>   fill_style;
+         style                   stroke_style;
+         style                   fill_style;
          int                     align          = 0;
 
          enum pattern_state { none_set, stroke_set, fill_set };
          pattern_state           pattern_set = none_set;
       };
 
-      using state_stack = std::stack<canvas_state>;
+      // Saved states are kept in a fixed-capacity inline array. Nesting
+      // deeper than that (rare) spills over to the heap.
+      static constexpr std::size_t inline_stack_size = 32;
+
+      using state_stack = std::array<canvas_state, inline_stack_size>;
+      using overflow_stack = std::vector<canvas_state>;
+
+      // The shape of the current path is tracked so that fill() and stroke()
+      // can write pixel aligned rectangles and hairlines directly into image
+      // surfaces. Handing out the cairo context makes it complex.
+      enum path_kind { path_empty, path_moved, path_rect, path_line, path_complex };
+
+      // The clip in target pixels, cached until the clip may have changed
+      enum clip_kind { clip_unknown, clip_pixels, clip_other };
+
+      struct pixel_rect
+      {
+         int left, top, right, bottom;
+      };
+
+      using pixel_rects = std::vector<pixel_rect>;
 
       cairo_t&          _context;
+      mutable path_kind _path_kind = path_empty;
+      elements::rect    _path_rect;    // The rect, or the line's end points
+      mutable clip_kind _clip_kind = clip_unknown;
+      pixel_rects       _clip_rects;
       canvas_state      _state;
+      bool              _reduced_quality = false;
       state_stack       _state_stack;
+      std::size_t       _state_depth = 0;
+      overflow_stack    _overflow_stack;
    };
 }}
 
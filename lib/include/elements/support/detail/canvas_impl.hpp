@@ -17,6 +17,9 @@ namespace cycfi { namespace elements
    ////////////////////////////////////////////////////////////////////////////
    inline cairo_t& canvas::cairo_context() const
    {
+      // The client may change the path or clip behind our back
+      _path_kind = path_complex;
+      _clip_kind = clip_unknown;
       return _context;
    }
 
@@ -104,20 +107,34 @@ namespace cycfi { namespace elements
 
    inline void canvas::apply_fill_style()
    {
-      if (_state.pattern_set != _state.fill_set && _state.fill_style)
+      if (!_state.fill_style)
+         return;
+      if (_state.pattern_set != _state.fill_set)
       {
-         _state.fill_style();
+         _state.fill_style.apply(_context);
          _state.pattern_set = _state.fill_set;
       }
+      else
+      {
+         // The source is already set, but its pattern may be shared
+         _state.fill_style.update_matrix();
+      }
    }
 
    inline void canvas::apply_stroke_style()
    {
-      if (_state.pattern_set != _state.stroke_set && _state.stroke_style)
+      if (!_state.stroke_style)
+         return;
+      if (_state.pattern_set != _state.stroke_set)
       {
-         _state.stroke_style();
+         _state.stroke_style.apply(_context);
          _state.pattern_set = _state.stroke_set;
       }
+      else
+      {
+         // The source is already set, but its pattern may be shared
+         _state.stroke_style.update_matrix();
+      }
    }
 }}
 
@@ -0,0 +1,35 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_DETAIL_DEVICE_SCALE_OCTOBER_18_2020)
+#define ELEMENTS_DETAIL_DEVICE_SCALE_OCTOBER_18_2020
+
+#include "cairo.h"
+
+namespace cycfi { namespace elements { namespace detail
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Returns the uniform scale from user space to device pixels, including
+   // the target surface's device scale (e.g. HiDPI on GTK), or 0 if user
+   // space is rotated, skewed or non-uniformly scaled.
+   ////////////////////////////////////////////////////////////////////////////
+   inline float device_scale(cairo_t& cr)
+   {
+      double dx = 1, dy = 0;
+      cairo_user_to_device_distance(&cr, &dx, &dy);
+      double sx = 0, sy = 1;
+      cairo_user_to_device_distance(&cr, &sx, &sy);
+      if (dy != 0 || sx != 0 || dx <= 0 || dx != sy)
+         return 0;
+
+      double xscale = 1, yscale = 1;
+      cairo_surface_get_device_scale(cairo_get_group_target(&cr), &xscale, &yscale);
+      if (xscale != yscale)
+         return 0;
+      return dx * xscale;
+   }
+}}}
+
+#endif
@@ -0,0 +1,41 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_DETAIL_MAPPED_FILE_OCTOBER_18_2020)
+#define ELEMENTS_DETAIL_MAPPED_FILE_OCTOBER_18_2020
+
+#include <infra/filesystem.hpp>
+#include <cstddef>
+
+namespace cycfi { namespace elements { namespace detail
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // mapped_file: A read-only memory mapped file. The pages are shared with
+   // all other processes mapping the same file.
+   ////////////////////////////////////////////////////////////////////////////
+   class mapped_file
+   {
+   public:
+                        mapped_file() = default;
+      explicit          mapped_file(fs::path const& path);
+                        mapped_file(mapped_file&& rhs) noexcept;
+                        ~mapped_file();
+
+      mapped_file&      operator=(mapped_file&& rhs) noexcept;
+      explicit          operator bool() const   { return _data != nullptr; }
+
+      char const*       data() const            { return _data; }
+      std::size_t       size() const            { return _size; }
+
+   private:
+                        mapped_file(mapped_file const&) = delete;
+      mapped_file&      operator=(mapped_file const&) = delete;
+
+      char const*       _data = nullptr;
+      std::size_t       _size = 0;
+   };
+}}}
+
+#endif
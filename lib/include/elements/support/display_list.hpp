@@ -0,0 +1,84 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_DISPLAY_LIST_OCTOBER_18_2020)
+#define ELEMENTS_DISPLAY_LIST_OCTOBER_18_2020
+
+#include <elements/support/canvas.hpp>
+#include <elements/support/rect.hpp>
+#include <string>
+
+namespace cycfi { namespace elements
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // display_list: A recording of canvas drawing (paths, styles, text,
+   // pixmaps, and anything else drawn through the canvas' cairo context)
+   // that can be replayed onto another canvas, through the target's
+   // current transform.
+   //
+   // Vector drawing replays at any resolution, but some drawing helpers
+   // rasterize at the device scale they see while recording: icons (see
+   // draw_icon), static_layer and shadows. Pass the device scale of the
+   // target to record (e.g. 2 on HiDPI, times the zoom), so that these are
+   // rasterized at that scale. Replayed at another scale, they are blurry.
+   //
+   // Copies share the same (immutable) recording. cairo does not make
+   // replaying the same recording from several threads at once safe; use
+   // clone to get an independent recording for each thread.
+   ////////////////////////////////////////////////////////////////////////////
+   class display_list
+   {
+   public:
+                        display_list() = default;
+                        display_list(display_list const& rhs);
+                        display_list(display_list&& rhs) noexcept;
+                        ~display_list();
+
+      display_list&     operator=(display_list const& rhs);
+      display_list&     operator=(display_list&& rhs) noexcept;
+
+      template <typename F>
+      void              record(F&& f, float scale = 1);
+      void              replay(canvas& cnv) const;
+      display_list      clone() const;
+      void              clear();
+
+      bool              empty() const  { return _surface == nullptr; }
+      rect              extents() const;
+
+      // Returns the area that needs to be redrawn if prev is replaced by
+      // this: empty if both draw the same, otherwise the union of both
+      // extents. Comparison is done on the serialized recordings, so this
+      // is meant for coarse grained decisions and for tests.
+      rect              diff(display_list const& prev) const;
+
+      // Serialize the recording as a cairo script, for inspection. Returns
+      // an empty string if cairo was built without script support.
+      std::string       serialize() const;
+
+   private:
+
+      cairo_t&          begin_recording(float scale);
+      void              end_recording();
+
+      cairo_surface_t*  _surface = nullptr;
+      cairo_t*          _recorder = nullptr;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename F>
+   inline void display_list::record(F&& f, float scale)
+   {
+      {
+         canvas cnv{ begin_recording(scale) };
+         f(cnv);
+      }
+      end_recording();
+   }
+}}
+
+#endif
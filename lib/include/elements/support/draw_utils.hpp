@@ -12,6 +12,9 @@ namespace cycfi { namespace elements
 {
    void draw_box_vgradient(canvas& cnv, rect bounds, float corner_radius = 4.0);
    void draw_panel(canvas& cnv, rect bounds, color c, float corner_radius = 4.0);
+   void draw_shadow(
+      canvas& cnv, rect bounds, float corner_radius
+    , float blur, point offset, color c);
    void draw_button(canvas& cnv, rect bounds, color c, float corner_radius = 4.0);
    void draw_knob(canvas& cnv, circle cp, color c);
    void draw_indicator(canvas& cnv, rect bounds, color c);
@@ -0,0 +1,115 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_FILMSTRIP_OCTOBER_18_2020)
+#define ELEMENTS_FILMSTRIP_OCTOBER_18_2020
+
+#include <elements/support/pixmap.hpp>
+#include <elements/support/point.hpp>
+#include <elements/support/color.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cycfi { namespace elements
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // compressed_filmstrip: A vertical filmstrip (e.g. the frames of a knob
+   // sprite) kept compressed in memory. Each frame is stored as a run
+   // length encoded xor delta against the previous frame, with periodic
+   // key frames, which works well for strips where only a small part of
+   // the image changes from one frame to the next.
+   //
+   // Only the requested frame is decoded, into a small cached pixmap.
+   // Stepping to a neighbouring frame applies a single delta (either way).
+   // A few recently decoded frames are kept around, and prefetch decodes
+   // the neighbours of a frame ahead of time (e.g. while dragging), from
+   // any thread.
+   //
+   // Frames may be colored as they are decoded: tinted (multiplied by a
+   // color) or recolored (filled with a color, keeping only the alpha), as
+   // with pixmap::tinted and pixmap::recolored. Decoded frames are cached
+   // by index and color.
+   //
+   // Copies share the compressed data, but decode on their own. Strips
+   // loaded from the same file (and with the same scale and frame height)
+   // share the compressed data as well.
+   ////////////////////////////////////////////////////////////////////////////
+   struct frame_coloring
+   {
+      enum mode_type { none, tint, recolor };
+
+      mode_type         mode = none;
+      color             color_;
+   };
+
+   class compressed_filmstrip
+   {
+   public:
+                        compressed_filmstrip(pixmap const& strip, float frame_height);
+                        compressed_filmstrip(
+                           char const* filename, float frame_height, float scale = 1
+                        );
+                        compressed_filmstrip(compressed_filmstrip const& rhs);
+
+      compressed_filmstrip& operator=(compressed_filmstrip const& rhs);
+
+      using coloring = frame_coloring;
+
+      std::size_t       num_frames() const;
+      extent            frame_size() const;
+      std::size_t       compressed_size() const;
+
+      pixmap_ptr        frame(std::size_t index, coloring col = {});
+      void              prefetch(std::size_t index, coloring col = {});
+
+   private:
+
+      struct data;
+      using data_ptr = std::shared_ptr<data const>;
+
+      // The color a frame is decoded with, as a cache key
+      struct color_key
+      {
+         coloring::mode_type        mode = coloring::none;
+         std::uint32_t              pixel = 0;
+
+         bool operator==(color_key const& rhs) const
+         {
+            return mode == rhs.mode && pixel == rhs.pixel;
+         }
+      };
+
+      struct cached_frame
+      {
+         std::size_t                index = -1;
+         color_key                  key;
+         std::size_t                last_used = 0;
+         std::shared_ptr<pixmap>    pm;
+      };
+
+      static constexpr std::size_t cache_size = 3;
+      using frame_cache = std::array<cached_frame, cache_size>;
+
+      static data_ptr   load(char const* filename, float frame_height, float scale);
+      static color_key  key_of(coloring col);
+
+      cached_frame*     find(std::size_t index, color_key key);
+      cached_frame&     decode(std::size_t index, coloring col, color_key key);
+      void              seek(std::size_t index);
+
+      std::mutex        _mutex;
+      data_ptr          _data;
+      std::vector<uint32_t> _pixels;
+      std::size_t       _current = -1;
+      std::size_t       _tick = 0;
+      frame_cache       _cache;
+   };
+}}
+
+#endif
@@ -104,9 +104,14 @@ namespace cycfi { namespace elements
       font&                operator=(font&& rhs) noexcept;
       explicit             operator bool() const;
 
+      // Fonts are equal if they are the same font face
+      bool                 operator==(font const& rhs) const   { return _handle == rhs._handle; }
+      bool                 operator!=(font const& rhs) const   { return _handle != rhs._handle; }
+
    private:
 
       friend class canvas;
+      friend class layer_key;
       cairo_font_face_t*  _handle   = nullptr;
    };
 
@@ -311,6 +316,12 @@ namespace cycfi { namespace elements
 #endif
 
    std::vector<fs::path>& font_paths();
+
+   // Location of the persistent font index, used to avoid scanning all the
+   // installed fonts at startup. Defaults to a file in the user's cache
+   // directory. Set to an empty path, before the first font is created, to
+   // disable the index.
+   fs::path& font_index_path();
 }}
 
 #endif
@@ -12,6 +12,7 @@
 #include <elements/support/text_utils.hpp>
 #include <cairo.h>
 #include <vector>
+#include <utility>
 #include <stdexcept>
 #include <string>
 
@@ -70,6 +71,7 @@ namespace cycfi { namespace elements
       cluster*             _clusters      = nullptr;
       int                  _cluster_count = 0;
       cluster_flags        _clusterflags;
+      float const*         _advances      = nullptr;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -133,6 +135,26 @@ namespace cycfi { namespace elements
       master_glyphs&       operator=(master_glyphs const& rhs) = delete;
 
       void                 build(point start = { 0, 0 });
+      void                 build_metrics();
+      void                 do_break_lines(float width, std::vector<glyphs>& lines);
+
+      // A break point is a space where a line may be broken
+      struct break_point
+      {
+         int               cluster;       // Index of the space cluster
+         char const*       pos;           // Position in the utf8 string
+         bool              newline;       // Explicit new line?
+      };
+
+      // Line breaks already computed, keyed by width, most recently used first
+      using line_breaks = std::pair<float, std::vector<glyphs>>;
+      static constexpr std::size_t line_break_cache_size = 8;
+
+      std::vector<float>         _glyph_advances;  // x advance per glyph
+      std::vector<float>         _cluster_right;   // right edge per cluster (ascending)
+      std::vector<int>           _cluster_glyph;   // first glyph index per cluster
+      std::vector<break_point>   _break_points;
+      std::vector<line_breaks>   _line_breaks;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -196,11 +218,20 @@ namespace cycfi { namespace elements
       {
          cairo_text_cluster_t* cluster = _clusters + i;
          cairo_glyph_t* glyph = _glyphs + glyph_index;
-         cairo_text_extents_t extents;
-         cairo_scaled_font_glyph_extents(_scaled_font, glyph, 1, &extents);
+         float advance;
+         if (_advances)
+         {
+            advance = _advances[glyph_index];
+         }
+         else
+         {
+            cairo_text_extents_t extents;
+            cairo_scaled_font_glyph_extents(_scaled_font, glyph, 1, &extents);
+            advance = extents.x_advance;
+         }
 
          float x = glyph->x - start_x;
-         if (!f(_first + byte_index, x, x + extents.x_advance))
+         if (!f(_first + byte_index, x, x + advance))
             break;
 
          // glyph/byte position
@@ -0,0 +1,49 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_PIXEL_OPS_OCTOBER_18_2020)
+#define ELEMENTS_PIXEL_OPS_OCTOBER_18_2020
+
+#include <elements/support/color.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace cycfi { namespace elements
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Pixel operations on cairo's native 32 bit ARGB pixels (premultiplied
+   // alpha, native endian uint32_t, as in pixmaps). These are vectorized
+   // where the target supports it (SSE2 or NEON), with a scalar fallback.
+   // On x86, AVX2 variants are used if the CPU supports them, even if the
+   // build does not target AVX2. All variants produce identical results.
+   ////////////////////////////////////////////////////////////////////////////
+
+   // Convert a color to a premultiplied ARGB32 pixel
+   uint32_t premultiplied_pixel(color c);
+
+   // Convert n RGBA pixels (bytes R, G, B, A with straight alpha, e.g. from
+   // image decoders) to premultiplied ARGB32. dest and src may be the same.
+   void rgba_to_argb32(uint32_t* dest, uint8_t const* src, std::size_t n);
+
+   // Convert n premultiplied ARGB32 pixels to straight alpha, in place
+   void unpremultiply(uint32_t* pixels, std::size_t n);
+
+   // Multiply n premultiplied ARGB32 pixels by color c, in place
+   void tint(uint32_t* pixels, std::size_t n, color c);
+
+   // Replace the color of n premultiplied ARGB32 pixels by c, keeping only
+   // their alpha (coverage), in place
+   void recolor(uint32_t* pixels, std::size_t n, color c);
+
+   // Composite src OVER the n pixels at dest
+   void fill_span(uint32_t* dest, std::size_t n, uint32_t src);
+
+   // Box blur an 8 bit alpha (A8) image in place. Each pixel becomes the
+   // average of the (2 * radius + 1) squared pixels around it, with pixels
+   // outside the image counting as zero. radius is clamped to [0, 127].
+   void box_blur(uint8_t* pixels, int width, int height, int stride, int radius);
+}}
+
+#endif
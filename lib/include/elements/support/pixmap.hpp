@@ -9,8 +9,14 @@
 #include <vector>
 #include <memory>
 #include <cairo.h>
+#include <elements/support/color.hpp>
 #include <elements/support/point.hpp>
+#include <elements/support/rect.hpp>
+#include <infra/filesystem.hpp>
 #include <stdexcept>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 
 namespace cycfi { namespace elements
 {
@@ -24,12 +30,17 @@ namespace cycfi { namespace elements
       using std::runtime_error::runtime_error;
    };
 
+   // Pixmaps are shared read-only (e.g. by load_pixmap and the color
+   // variants). Draw into, or rescale, a pixmap of your own instead.
+   class pixmap;
+   using pixmap_ptr = std::shared_ptr<pixmap const>;
+
    class pixmap
    {
    public:
 
       explicit          pixmap(point size, float scale = 1);
-      explicit          pixmap(char const* filename, float scale = 1);
+      explicit          pixmap(char const* filename, float scale = 1, bool raster_cache = true);
                         pixmap(pixmap const& rhs) = delete;
                         pixmap(pixmap&& rhs);
                         ~pixmap();
@@ -41,15 +52,92 @@ namespace cycfi { namespace elements
       float             scale() const;
       void              scale(float val);
 
+      // Copies of this pixmap multiplied by a color (tinted), or filled with
+      // a color, keeping only the alpha (recolored, e.g. for monochrome icons
+      // and glyphs). These are computed once per color and cached with this
+      // pixmap until it is drawn into. Only the few most recently used
+      // colors are kept. Thread-safe.
+      pixmap_ptr        tinted(color c) const;
+      pixmap_ptr        recolored(color c) const;
+
+      // Identifies the pixmap's current contents and scale, e.g. for cache
+      // keys. Unique across pixmaps and changed whenever the pixmap is
+      // drawn into or rescaled.
+      std::uint64_t     generation() const   { return _generation; }
+
    private:
 
       friend class canvas;
       friend class pixmap_context;
+      friend class compressed_filmstrip;
+      friend pixmap_ptr load_pixmap(char const* filename, float scale);
+
+      // Downscaled variants (mipmaps) for drawing at less than half size.
+      // These are generated lazily, as needed, by whichever thread draws
+      // the pixmap. variant returns a new reference to the surface to draw
+      // src (the part of the pixmap drawn) from. Each variant pixel averages
+      // a square of pixels, so the variant is coarser if needed for src's
+      // edges to fall between such squares, e.g. for sprite frames.
+      using variants = std::vector<cairo_surface_t*>;
+
+      cairo_surface_t*  variant(float ratio, rect src) const;
+      void              clear_variants();
+      void              make_writable();
+
+      struct color_variant
+      {
+         std::uint32_t  pixel;
+         bool           recolor;
+         pixmap_ptr     pm;
+      };
+
+      using color_variants = std::vector<color_variant>;
+
+      pixmap_ptr        color_variant_of(color c, bool recolor) const;
+      static std::uint64_t next_generation();
 
       cairo_surface_t*  _surface;
+      mutable variants  _variants;
+      mutable color_variants _color_variants;
+      std::atomic<std::uint64_t> _generation{ next_generation() };
    };
 
-   using pixmap_ptr = std::shared_ptr<pixmap>;
+   ////////////////////////////////////////////////////////////////////////////
+   // Shared pixmap resources. load_pixmap returns the same pixmap for the
+   // same file (after resolving it against the resource_paths) and scale,
+   // for as long as someone holds on to it. Recently used pixmaps are also
+   // retained after their last user lets go, up to the cache budget (in
+   // bytes), so that reloading them is cheap. Set the budget to zero to
+   // drop pixmaps as soon as they are unused. These are thread-safe.
+   //
+   // Pixmaps from load_pixmap are shared, hence const. To draw into one or
+   // change its scale, load a private copy with the pixmap constructor.
+   ////////////////////////////////////////////////////////////////////////////
+   pixmap_ptr           load_pixmap(char const* filename, float scale = 1);
+   void                 pixmap_cache_budget(std::size_t bytes);
+   std::size_t          pixmap_cache_budget();
+   std::size_t          pixmap_cache_size();
+   void                 clear_pixmap_cache();
+
+   ////////////////////////////////////////////////////////////////////////////
+   // The raster cache keeps decoded images on disk, ready to use: native,
+   // premultiplied ARGB32 (or RGB24) pixels, keyed by a hash of the source
+   // file's contents. Pixmaps loaded from files memory map their cached
+   // raster, if there is one, instead of decoding the file again, and save
+   // one otherwise. Rasters are shared with all other processes mapping the
+   // same file and are copied only when drawn into (see pixmap_context).
+   //
+   // Pass raster_cache = false to the pixmap constructor to bypass it for
+   // images not worth caching, e.g. tiles. The cache is off by default.
+   // Enable it by setting its directory, e.g.
+   // raster_cache_path(cache_path() / "rasters"). Rasters are uncompressed,
+   // so the cache is kept within a budget (in bytes, 256 MB by default) by
+   // removing the least recently used rasters. These are thread-safe.
+   ////////////////////////////////////////////////////////////////////////////
+   void                 raster_cache_path(fs::path const& path);
+   fs::path             raster_cache_path();
+   void                 raster_cache_budget(std::size_t bytes);
+   std::size_t          raster_cache_budget();
 
    ////////////////////////////////////////////////////////////////////////////
    // pixmap_context allows drawing into a pixmap
@@ -60,6 +148,8 @@ namespace cycfi { namespace elements
 
       explicit          pixmap_context(pixmap& pm)
                         {
+                           pm.clear_variants();
+                           pm.make_writable();
                            _context = cairo_create(pm._surface);
                         }
 
@@ -88,16 +178,29 @@ namespace cycfi { namespace elements
    ////////////////////////////////////////////////////////////////////////////
    inline pixmap::pixmap(pixmap&& rhs)
     : _surface(rhs._surface)
+    , _variants(std::move(rhs._variants))
+    , _color_variants(std::move(rhs._color_variants))
+    , _generation(rhs._generation.load())
    {
+      rhs._generation = next_generation();
       rhs._surface = nullptr;
+      rhs._variants.clear();
+      rhs._color_variants.clear();
    }
 
    inline pixmap& pixmap::operator=(pixmap&& rhs)
    {
       if (this != &rhs)
       {
+         clear_variants();
          _surface = rhs._surface;
+         _variants = std::move(rhs._variants);
+         _color_variants = std::move(rhs._color_variants);
+         _generation = rhs._generation.load();
+         rhs._generation = next_generation();
          rhs._surface = nullptr;
+         rhs._variants.clear();
+         rhs._color_variants.clear();
       }
       return *this;
    }
@@ -0,0 +1,69 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_RESOURCE_BUNDLE_OCTOBER_18_2020)
+#define ELEMENTS_RESOURCE_BUNDLE_OCTOBER_18_2020
+
+#include <infra/filesystem.hpp>
+#include <infra/string_view.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cycfi { namespace elements
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Resource bundles: Resources (images, fonts, etc.) packed in a single
+   // read-only blob that is linked into the binary (see the CMake function
+   // elements_add_resource_bundle) or memory mapped from a single file.
+   // Once mounted, bundled resources are found before the resource_paths
+   // and read directly from memory, without touching the file system.
+   //
+   // find_file returns bundled resources as "res://<name>" paths, where
+   // name is the resource's path within the bundle (e.g. "images/knob.png").
+   // Pixmaps and fonts load these from memory.
+   //
+   // Bundles stay mounted for the life of the process. Mount them at
+   // startup, before loading any fonts.
+   //
+   // Bundle layout (little endian, offsets from the start of the bundle):
+   //
+   //    header            magic "ERBX", uint32 version, uint32 num_entries,
+   //                      uint32 reserved
+   //    entry[num_entries]
+   //                      uint32 name offset, uint32 name size,
+   //                      uint64 data offset, uint64 data size
+   //                      (sorted by name)
+   //    names and data
+   ////////////////////////////////////////////////////////////////////////////
+   struct resource
+   {
+      explicit          operator bool() const   { return data != nullptr; }
+
+      char const*       data = nullptr;
+      std::size_t       size = 0;
+   };
+
+   constexpr char const* resource_path_prefix = "res://";
+
+   // Mount a bundle in memory that outlives the process' use of it (e.g.
+   // an array linked into the binary). Returns false if data is not a valid
+   // bundle.
+   bool                 mount_resource_bundle(void const* data, std::size_t size);
+
+   // Memory map a bundle file and mount it. Returns false if the file can't
+   // be mapped or is not a valid bundle.
+   bool                 mount_resource_bundle(fs::path const& path);
+
+   // Find a bundled resource by name, or by the "res://" path find_file
+   // returned for it. Returns an empty resource if not found. Bundles
+   // mounted later are searched first.
+   resource             find_resource(string_view name);
+
+   // The "res://" paths of all the bundled resources
+   std::vector<std::string> resource_bundle_paths();
+}}
+
+#endif
@@ -22,11 +22,16 @@ namespace cycfi { namespace elements
    extern std::vector<fs::path> resource_paths;
 
    // Search for a file using the resource_paths. Returns an empty
-   // string if file is not found.
+   // string if file is not found. Resources in mounted bundles (see
+   // resource_bundle.hpp) are found first, as "res://" paths.
    std::string find_file(string_view file);
 
    // Get the application data path
    fs::path app_data_path();
+
+   // Get the directory for elements' caches, in the user's cache directory
+   // (e.g. ~/.cache/elements). Returns an empty path if there is none.
+   fs::path cache_path();
 }}
 
 #endif
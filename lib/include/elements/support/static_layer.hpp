@@ -0,0 +1,169 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ELEMENTS_STATIC_LAYER_OCTOBER_18_2020)
+#define ELEMENTS_STATIC_LAYER_OCTOBER_18_2020
+
+#include <elements/support/canvas.hpp>
+#include <elements/support/font.hpp>
+#include <elements/support/rect.hpp>
+#include <elements/support/detail/device_scale.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace cycfi { namespace elements
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // layer_key: A hash (64-bit FNV-1a) of the inputs a static_layer's
+   // drawing depends on. Keys are built on every draw, so they do not
+   // allocate. Fonts are hashed by face, so a font matches only the very
+   // same font face.
+   ////////////////////////////////////////////////////////////////////////////
+   class layer_key
+   {
+   public:
+
+      template <typename T>
+      layer_key&        add(T const& val);
+      layer_key&        add(std::string const& s);
+      layer_key&        add(font const& f);
+
+      bool              operator==(layer_key const& rhs) const { return _hash == rhs._hash; }
+      bool              operator!=(layer_key const& rhs) const { return _hash != rhs._hash; }
+
+   private:
+
+      layer_key&        add_bytes(char const* p, std::size_t n);
+
+      std::uint64_t     _hash = 0xcbf29ce484222325;   // FNV offset basis
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // static_layer: Caches drawing that does not change from frame to frame
+   // (e.g. the body and tick marks of a dial) in a device resolution surface.
+   // The drawing is redone only when the bounds' size, the device scale or
+   // the client supplied key changes. Otherwise, the cached surface is
+   // blitted 1:1, snapped to device pixels.
+   //
+   // margin is the extra space around bounds that the drawing may cover
+   // (e.g. antialiasing or text that extends outside the bounds). It may
+   // also be a function, margin(cnv), called only when the drawing is
+   // redone, e.g. to measure text. When the canvas is rotated or skewed,
+   // the drawing is done directly.
+   ////////////////////////////////////////////////////////////////////////////
+   class static_layer
+   {
+   public:
+                        static_layer() = default;
+                        static_layer(static_layer const& rhs);
+                        ~static_layer();
+
+      static_layer&     operator=(static_layer const& rhs);
+
+      template <typename M, typename F>
+      void              draw(
+                           canvas& cnv, rect bounds, M const& margin
+                         , layer_key const& key, F&& f
+                        );
+
+      void              invalidate();
+
+   private:
+
+      bool              valid(rect bounds, float scale, layer_key const& key) const;
+      cairo_t*          begin_update(rect bounds, float margin, float scale, layer_key const& key);
+      void              end_update(cairo_t* cr);
+      void              blit(canvas& cnv, rect bounds) const;
+
+      cairo_surface_t*  _surface = nullptr;
+      extent            _size;
+      float             _margin = 0;
+      float             _scale = 0;
+      layer_key         _key;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline layer_key& layer_key::add_bytes(char const* p, std::size_t n)
+   {
+      for (std::size_t i = 0; i != n; ++i)
+      {
+         _hash ^= static_cast<unsigned char>(p[i]);
+         _hash *= 0x100000001b3;                      // FNV prime
+      }
+      return *this;
+   }
+
+   template <typename T>
+   inline layer_key& layer_key::add(T const& val)
+   {
+      static_assert(std::is_trivially_copyable<T>::value
+       , "layer_key: unsupported type");
+      return add_bytes(reinterpret_cast<char const*>(&val), sizeof(T));
+   }
+
+   inline layer_key& layer_key::add(std::string const& s)
+   {
+      add(s.size());
+      return add_bytes(s.data(), s.size());
+   }
+
+   inline layer_key& layer_key::add(font const& f)
+   {
+      return add(f._handle);
+   }
+
+   namespace detail
+   {
+      inline float layer_margin(float margin, canvas& /* cnv */)
+      {
+         return margin;
+      }
+
+      template <typename M>
+      inline auto layer_margin(M const& margin, canvas& cnv)
+         -> decltype(float(margin(cnv)))
+      {
+         return margin(cnv);
+      }
+   }
+
+   template <typename M, typename F>
+   inline void static_layer::draw(
+      canvas& cnv, rect bounds, M const& margin_, layer_key const& key, F&& f)
+   {
+      auto scale = detail::device_scale(cnv.cairo_context());
+      if (scale <= 0)
+      {
+         f(cnv);
+         return;
+      }
+
+      if (!valid(bounds, scale, key))
+      {
+         auto margin = detail::layer_margin(margin_, cnv);
+         if (auto cr = begin_update(bounds, margin, scale, key))
+         {
+            {
+               canvas layer_cnv{ *cr };
+               f(layer_cnv);
+            }
+            end_update(cr);
+         }
+         else
+         {
+            f(cnv);
+            return;
+         }
+      }
+      blit(cnv, bounds);
+   }
+}}
+
+#endif
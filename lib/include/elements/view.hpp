@@ -16,6 +16,8 @@
 #include <elements/element/indirect.hpp>
 #include <asio.hpp>
 #include <memory>
+#include <mutex>
+#include <stack>
 #include <unordered_map>
 #include <chrono>
 
@@ -24,6 +26,42 @@ namespace cycfi { namespace elements
    class context;
    class window;
    class idle_tasks;
+   class view;
+
+   ////////////////////////////////////////////////////////////////////////////
+   // The thread pool shared by all background work in the library: image
+   // loading, tiled drawing, etc.
+   ////////////////////////////////////////////////////////////////////////////
+   asio::thread_pool&         worker_pool();
+
+   ////////////////////////////////////////////////////////////////////////////
+   // weak_view: A weak reference to a view, for background work (e.g. image
+   // loaders) to refresh it, from any thread. It does nothing once the view
+   // is destroyed. refresh(e) computes e's area when it runs on the UI
+   // thread, so it is right even if e moved in the meantime. e is only
+   // compared with the elements in the view, never dereferenced there.
+   ////////////////////////////////////////////////////////////////////////////
+   class weak_view
+   {
+   public:
+
+      void                    refresh() const;
+      void                    refresh(element& e) const;
+
+   private:
+
+      friend class view;
+
+      struct link
+      {
+         std::mutex           mutex;
+         view*                view_ = nullptr;
+      };
+
+      using link_ptr = std::shared_ptr<link>;
+
+      std::weak_ptr<link>     _link;
+   };
 
    class view : public base_view
    {
@@ -42,6 +80,8 @@ namespace cycfi { namespace elements
       void                    text(text_info const& info) override;
       void                    begin_focus() override;
       void                    end_focus() override;
+      void                    begin_live_resize() override;
+      void                    end_live_resize() override;
       void                    poll() override;
 
       void                    layout();
@@ -49,6 +89,17 @@ namespace cycfi { namespace elements
       float                   scale() const;
       void                    scale(float val);
 
+      // Large repaints (e.g. full window repaints on resize) may be split
+      // into tiles that are rasterized in parallel. Off by default.
+      void                    tiled_drawing(bool enable);
+      bool                    tiled_drawing() const;
+
+      // Draw at reduced quality (see canvas::reduced_quality) while the
+      // user drags, scrolls or live resizes the window, then redraw at full
+      // quality once that ends, or pauses for a moment. Off by default.
+      void                    reduced_quality_while_tracking(bool enable);
+      bool                    reduced_quality_while_tracking() const;
+
       void                    refresh() override;
       void                    refresh(rect area) override;
       void                    refresh(element& element, int outward = 0);
@@ -107,6 +158,8 @@ namespace cycfi { namespace elements
 
       void                    manage_on_tracking(element& e, tracking state);
 
+      weak_view               get_weak_view() const;
+
    private:
 
       scaled_content          make_scaled_content() { return elements::scale(1.0, link(_content)); }
@@ -115,12 +168,19 @@ namespace cycfi { namespace elements
       scaled_content          _main_element;
 
       bool                    set_limits();
+      bool                    draw_tiles(cairo_t& context_, rect subj_bounds);
+      bool                    reduced_quality() const;
+      void                    restore_quality();
 
       rect                    _dirty;
       rect                    _current_bounds;
       view_limits             _current_limits = { { 0, 0 }, { full_extent, full_extent} };
       mouse_button            _current_button;
       bool                    _is_focus = false;
+      bool                    _tiled_drawing = false;
+      bool                    _reduce_quality_while_tracking = false;
+      bool                    _drawn_reduced = false;
+      bool                    _live_resizing = false;
 
       using undo_stack_type = std::stack<undo_redo_task>;
       undo_stack_type         _undo_stack;
@@ -128,6 +188,7 @@ namespace cycfi { namespace elements
 
       io_context              _io;
       io_context::work        _work;
+      weak_view::link_ptr     _link;
 
       using time_point = std::chrono::steady_clock::time_point;
       element*                _tracking_element = nullptr;
@@ -143,6 +204,26 @@ namespace cycfi { namespace elements
       return _dirty;
    }
 
+   inline void view::tiled_drawing(bool enable)
+   {
+      _tiled_drawing = enable;
+   }
+
+   inline bool view::tiled_drawing() const
+   {
+      return _tiled_drawing;
+   }
+
+   inline void view::reduced_quality_while_tracking(bool enable)
+   {
+      _reduce_quality_while_tracking = enable;
+   }
+
+   inline bool view::reduced_quality_while_tracking() const
+   {
+      return _reduce_quality_while_tracking;
+   }
+
    inline bool view::has_undo()
    {
       return !_undo_stack.empty();
@@ -257,6 +338,13 @@ namespace cycfi { namespace elements
       return _io;
    }
 
+   inline weak_view view::get_weak_view() const
+   {
+      weak_view wv;
+      wv._link = _link;
+      return wv;
+   }
+
    inline mouse_button view::current_button() const
    {
       return _current_button;
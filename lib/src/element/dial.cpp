@@ -8,6 +8,8 @@
 #include <elements/support/theme.hpp>
 #include <elements/view.hpp>
 #include <cmath>
+#include <algorithm>
+#include <functional>
 
 #include <iostream>
 
@@ -182,4 +184,83 @@ namespace cycfi { namespace elements
          cnv.fill_text({ cp.radius * cos_, cp.radius * sin_ }, labels[i].c_str());
       }
    }
+
+   void draw_knob(canvas& cnv, static_layer& layer, circle cp, color c)
+   {
+      layer_key key;
+      key.add(c);
+
+      // The knob (sans indicator) does not depend on the dial's value
+      layer.draw(cnv, cp.bounds(), 1, key,
+         [&](canvas& cnv_)
+         {
+            draw_knob(cnv_, cp, c);
+         }
+      );
+   }
+
+   void draw_radial_marks(
+      canvas& cnv, static_layer& layer, circle cp, float size, color c)
+   {
+      auto const& theme = get_theme();
+      layer_key key;
+      key.add(size)
+         .add(c)
+         .add(theme.ticks_color)
+         .add(theme.major_ticks_level)
+         .add(theme.major_ticks_width)
+         .add(theme.minor_ticks_level)
+         .add(theme.minor_ticks_width);
+
+      auto margin = std::max(theme.major_ticks_width, theme.minor_ticks_width) + 1;
+      layer.draw(cnv, cp.bounds(), margin, key,
+         [&](canvas& cnv_)
+         {
+            draw_radial_marks(cnv_, cp, size, c);
+         }
+      );
+   }
+
+   void draw_radial_labels(
+      canvas& cnv
+    , static_layer& layer
+    , circle cp
+    , float size
+    , float font_size
+    , std::string const labels[]
+    , std::size_t num_labels
+   )
+   {
+      auto const& theme = get_theme();
+      layer_key key;
+      key.add(size)
+         .add(font_size)
+         .add(theme.label_font)
+         .add(theme.label_font_size)
+         .add(theme.label_font_color);
+      for (std::size_t i = 0; i != num_labels; ++i)
+         key.add(labels[i]);
+
+      // The labels are centered on the circle and extend outside it by
+      // up to half their extent
+      auto margin = [&](canvas& cnv_)
+      {
+         auto state = cnv_.new_state();
+         cnv_.font(theme.label_font, theme.label_font_size * font_size);
+         float margin_ = 1;
+         for (std::size_t i = 0; i != num_labels; ++i)
+         {
+            auto m = cnv_.measure_text(labels[i].c_str());
+            margin_ = std::max(margin_, std::max(m.size.x, m.size.y) / 2 + 1);
+         }
+         return margin_;
+      };
+
+      layer.draw(cnv, cp.bounds(), margin, key,
+         [&](canvas& cnv_)
+         {
+            draw_radial_labels(cnv_, cp, size, font_size, labels, num_labels);
+         }
+      );
+   }
 }}
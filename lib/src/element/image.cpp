@@ -6,7 +6,10 @@
 #include <elements/element/image.hpp>
 #include <elements/support.hpp>
 #include <elements/support/context.hpp>
+#include <elements/view.hpp>
 #include <algorithm>
+#include <mutex>
+#include <string>
 
 namespace cycfi { namespace elements
 {
@@ -14,7 +17,7 @@ namespace cycfi { namespace elements
    // image implementation
    ////////////////////////////////////////////////////////////////////////////
    image::image(char const* filename, float scale)
-    : _pixmap(std::make_shared<elements::pixmap>(filename, scale))
+    : _pixmap(load_pixmap(filename, scale))
    {
    }
 
@@ -41,7 +44,128 @@ namespace cycfi { namespace elements
    void image::draw(context const& ctx)
    {
       auto src = source_rect(ctx);
-      ctx.canvas.draw(pixmap(), src, ctx.bounds);
+      ctx.canvas.draw(*colored_pixmap(), src, ctx.bounds);
+   }
+
+   void image::tint(color c)
+   {
+      _color_mode = tint_color;
+      _color = c;
+   }
+
+   void image::recolor(color c)
+   {
+      _color_mode = recolor_color;
+      _color = c;
+   }
+
+   void image::clear_tint()
+   {
+      _color_mode = no_color;
+   }
+
+   pixmap_ptr image::colored(elements::pixmap const& pm) const
+   {
+      switch (_color_mode)
+      {
+         case tint_color:     return pm.tinted(_color);
+         case recolor_color:  return pm.recolored(_color);
+         default:             return {};
+      }
+   }
+
+   // The pixmap to draw: the colored pixmap, if any, or the source
+   pixmap_ptr image::colored_pixmap() const
+   {
+      auto pm = colored(*_pixmap);
+      return pm? pm : _pixmap;
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // async_image implementation
+   ////////////////////////////////////////////////////////////////////////////
+   // State shared with the loader. The view and the element are set when
+   // the placeholder is drawn, so that the loader knows what to refresh.
+   // The element is reset when it goes away. The element's area is
+   // computed when the refresh runs, in case it moved.
+   struct async_image::state
+   {
+      std::mutex              mutex;
+      pixmap_ptr              pixmap;
+      bool                    done = false;
+      weak_view               view_;
+      element*                self = nullptr;
+   };
+
+   async_image::async_image(
+      char const* filename, extent size, float scale, color placeholder)
+    : _state(std::make_shared<state>())
+    , _size(size)
+    , _placeholder(placeholder)
+   {
+      asio::post(worker_pool(),
+         [state_ = _state, path = std::string(filename), scale]()
+         {
+            pixmap_ptr pm;
+            try
+            {
+               pm = load_pixmap(path.c_str(), scale);
+            }
+            catch (failed_to_load_pixmap const&)
+            {
+            }
+
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->pixmap = pm;
+            state_->done = true;
+            if (pm && state_->self)
+               state_->view_.refresh(*state_->self);  // Posted to the UI thread
+         }
+      );
+   }
+
+   async_image::~async_image()
+   {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      _state->self = nullptr;
+   }
+
+   view_limits async_image::limits(basic_context const& /* ctx */) const
+   {
+      return { { _size.x, _size.y }, { _size.x, _size.y } };
+   }
+
+   void async_image::draw(context const& ctx)
+   {
+      if (auto pm = get_pixmap())
+      {
+         ctx.canvas.draw(*pm, ctx.bounds);
+         return;
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(_state->mutex);
+         if (!_state->done)
+         {
+            _state->view_ = ctx.view.get_weak_view();
+            _state->self = this;
+         }
+      }
+
+      auto& cnv = ctx.canvas;
+      cnv.fill_style(_placeholder);
+      cnv.fill_rect(ctx.bounds);
+   }
+
+   bool async_image::is_ready() const
+   {
+      return get_pixmap() != nullptr;
+   }
+
+   pixmap_ptr async_image::get_pixmap() const
+   {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      return _state->pixmap;
    }
 
    ////////////////////////////////////////////////////////////////////////////
@@ -95,6 +219,14 @@ namespace cycfi { namespace elements
          parts[1] = corner.move(dest.left, dest.bottom - (div_v+1));
          parts[2] = max(parts[0], parts[1]).inset(0, div_v);
       }
+
+      // The composed patches depend only on the contents of the pixmap
+      // drawn, colored or not (the layer takes care of the size and device
+      // scale)
+      layer_key patches_key(pixmap const& pm)
+      {
+         return layer_key{}.add(pm.generation());
+      }
    }
 
    gizmo::gizmo(char const* filename, float scale)
@@ -113,16 +245,22 @@ namespace cycfi { namespace elements
 
    void gizmo::draw(context const& ctx)
    {
-      rect  src[9];
-      rect  dest[9];
-      auto  size_ = size();
-      rect  src_bounds{ 0, 0, size_.x, size_.y };
-
-      gizmo_parts(src_bounds, src_bounds, src);
-      gizmo_parts(src_bounds, ctx.bounds, dest);
-
-      for (int i = 0; i < 9; i++)
-         ctx.canvas.draw(pixmap(), src[i], dest[i]);
+      auto pm = colored_pixmap();
+      _layer.draw(ctx.canvas, ctx.bounds, 0, patches_key(*pm),
+         [&](canvas& cnv)
+         {
+            rect  src[9];
+            rect  dest[9];
+            auto  size_ = size();
+            rect  src_bounds{ 0, 0, size_.x, size_.y };
+
+            gizmo_parts(src_bounds, src_bounds, src);
+            gizmo_parts(src_bounds, ctx.bounds, dest);
+
+            for (int i = 0; i < 9; i++)
+               cnv.draw(*pm, src[i], dest[i]);
+         }
+      );
    }
 
    hgizmo::hgizmo(char const* filename, float scale)
@@ -141,16 +279,22 @@ namespace cycfi { namespace elements
 
    void hgizmo::draw(context const& ctx)
    {
-      rect  src[3];
-      rect  dest[3];
-      auto  size_ = size();
-      rect  src_bounds{ 0, 0, size_.x, size_.y };
-
-      hgizmo_parts(src_bounds, src_bounds, src);
-      hgizmo_parts(src_bounds, ctx.bounds, dest);
-      ctx.canvas.draw(pixmap(), src[0], dest[0]);
-      ctx.canvas.draw(pixmap(), src[1], dest[1]);
-      ctx.canvas.draw(pixmap(), src[2], dest[2]);
+      auto pm = colored_pixmap();
+      _layer.draw(ctx.canvas, ctx.bounds, 0, patches_key(*pm),
+         [&](canvas& cnv)
+         {
+            rect  src[3];
+            rect  dest[3];
+            auto  size_ = size();
+            rect  src_bounds{ 0, 0, size_.x, size_.y };
+
+            hgizmo_parts(src_bounds, src_bounds, src);
+            hgizmo_parts(src_bounds, ctx.bounds, dest);
+
+            for (int i = 0; i < 3; i++)
+               cnv.draw(*pm, src[i], dest[i]);
+         }
+      );
    }
 
    vgizmo::vgizmo(char const* filename, float scale)
@@ -169,16 +313,22 @@ namespace cycfi { namespace elements
 
    void vgizmo::draw(context const& ctx)
    {
-      rect  src[3];
-      rect  dest[3];
-      auto  size_ = size();
-      rect  src_bounds{ 0, 0, size_.x, size_.y };
-
-      vgizmo_parts(src_bounds, src_bounds, src);
-      vgizmo_parts(src_bounds, ctx.bounds, dest);
-      ctx.canvas.draw(pixmap(), src[0], dest[0]);
-      ctx.canvas.draw(pixmap(), src[1], dest[1]);
-      ctx.canvas.draw(pixmap(), src[2], dest[2]);
+      auto pm = colored_pixmap();
+      _layer.draw(ctx.canvas, ctx.bounds, 0, patches_key(*pm),
+         [&](canvas& cnv)
+         {
+            rect  src[3];
+            rect  dest[3];
+            auto  size_ = size();
+            rect  src_bounds{ 0, 0, size_.x, size_.y };
+
+            vgizmo_parts(src_bounds, src_bounds, src);
+            vgizmo_parts(src_bounds, ctx.bounds, dest);
+
+            for (int i = 0; i < 3; i++)
+               cnv.draw(*pm, src[i], dest[i]);
+         }
+      );
    }
 
    basic_sprite::basic_sprite(char const* filename, float height, float scale)
@@ -187,14 +337,56 @@ namespace cycfi { namespace elements
     , _height(height)
    {}
 
+   basic_sprite::basic_sprite(
+      char const* filename, float height, float scale, compressed_frames_tag)
+    : image(pixmap_ptr{})
+    , _index(0)
+    , _height(height)
+    , _frames(std::make_shared<compressed_filmstrip>(filename, height, scale))
+   {}
+
+   float basic_sprite::width() const
+   {
+      return _frames? _frames->frame_size().x : pixmap().size().x;
+   }
+
    view_limits basic_sprite::limits(basic_context const& /* ctx */) const
    {
-      auto width = pixmap().size().x;
-      return { { width, _height }, { width, _height } };
+      auto width_ = width();
+      return { { width_, _height }, { width_, _height } };
+   }
+
+   void basic_sprite::draw(context const& ctx)
+   {
+      if (!_frames)
+         return image::draw(ctx);
+
+      compressed_filmstrip::coloring col;
+      if (_color_mode == tint_color)
+         col = { col.tint, _color };
+      else if (_color_mode == recolor_color)
+         col = { col.recolor, _color };
+
+      ctx.canvas.draw(*_frames->frame(_index, col), ctx.bounds);
+
+      // Decode the neighbouring frames in the background, ready for
+      // dragging. Once per frame shown, not per draw.
+      if (_prefetched != _index)
+      {
+         _prefetched = _index;
+         asio::post(worker_pool(),
+            [frames = _frames, index = _index, col]()
+            {
+               frames->prefetch(index, col);
+            }
+         );
+      }
    }
 
    std::size_t basic_sprite::num_frames() const
    {
+      if (_frames)
+         return _frames->num_frames();
       return pixmap().size().y / _height;
    }
 
@@ -206,12 +398,12 @@ namespace cycfi { namespace elements
 
    point basic_sprite::size() const
    {
-      return { pixmap().size().x, _height };
+      return { width(), _height };
    }
 
    rect basic_sprite::source_rect(context const& /* ctx */) const
    {
-      auto width = pixmap().size().x;
-      return rect{ 0, _height * _index, width, _height * (_index + 1) };
+      auto width_ = width();
+      return rect{ 0, _height * _index, width_, _height * (_index + 1) };
    }
 }}
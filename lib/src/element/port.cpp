@@ -298,7 +298,11 @@ namespace cycfi { namespace elements
       }
 
       if (redraw)
+      {
+         // Scrolling counts as tracking (e.g. for reduced quality drawing)
+         on_tracking(ctx, while_tracking);
          ctx.view.refresh(ctx);
+      }
       return redraw;
    }
 
@@ -312,6 +316,8 @@ namespace cycfi { namespace elements
             if (reposition(ctx, btn.pos))
                return ctx.element;
          }
+         else if (_tracking != none)
+            on_tracking(ctx, end_tracking);
          _tracking = none;
          refresh(ctx);
       }
@@ -353,6 +359,7 @@ namespace cycfi { namespace elements
       {
          clamp(align, 0.0, 1.0);
          valign(align);
+         on_tracking(ctx, while_tracking);
          ctx.view.refresh(ctx);
       };
 
@@ -360,6 +367,7 @@ namespace cycfi { namespace elements
       {
          clamp(align, 0.0, 1.0);
          halign(align);
+         on_tracking(ctx, while_tracking);
          ctx.view.refresh(ctx);
       };
 
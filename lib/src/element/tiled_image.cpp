@@ -0,0 +1,365 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <elements/element/tiled_image.hpp>
+#include <elements/support/canvas.hpp>
+#include <elements/support/context.hpp>
+#include <elements/support/detail/device_scale.hpp>
+#include <elements/view.hpp>
+#include <infra/support.hpp>
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace cycfi { namespace elements
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // tile_source implementation
+   ////////////////////////////////////////////////////////////////////////////
+   tile_source::tile_source(extent size, int tile_size, int num_levels)
+    : _size(size)
+    , _tile_size(std::max(tile_size, 1))
+    , _num_levels(num_levels)
+   {
+      if (_num_levels <= 0)
+      {
+         // Down to the level that fits in a single tile
+         _num_levels = 1;
+         for (auto s = std::max(size.x, size.y); s > _tile_size; s = std::ceil(s / 2))
+            ++_num_levels;
+      }
+   }
+
+   extent tile_source::level_size(int level) const
+   {
+      auto s = _size;
+      for (int i = 0; i != level; ++i)
+         s = { std::ceil(s.x / 2), std::ceil(s.y / 2) };
+      return s;
+   }
+
+   int tile_source::num_cols(int level) const
+   {
+      return std::ceil(level_size(level).x / _tile_size);
+   }
+
+   int tile_source::num_rows(int level) const
+   {
+      return std::ceil(level_size(level).y / _tile_size);
+   }
+
+   directory_tile_source::directory_tile_source(
+      fs::path path, extent size, int tile_size, int num_levels, std::string ext)
+    : tile_source(size, tile_size, num_levels)
+    , _path(std::move(path))
+    , _ext(std::move(ext))
+   {
+   }
+
+   pixmap_ptr directory_tile_source::load(tile_key key)
+   {
+      auto path = _path / std::to_string(key.level)
+         / (std::to_string(key.col) + '_' + std::to_string(key.row) + '.' + _ext);
+      if (!fs::exists(path))
+         return {};
+
+      // Tiles are cached by the tiled_image, not by the pixmap or raster
+      // caches
+      try
+      {
+         return std::make_shared<pixmap>(path.string().c_str(), 1, false);
+      }
+      catch (failed_to_load_pixmap const&)
+      {
+         return {};
+      }
+   }
+
+   callback_tile_source::callback_tile_source(
+      load_function load, extent size, int tile_size, int num_levels)
+    : tile_source(size, tile_size, num_levels)
+    , _load(std::move(load))
+   {
+   }
+
+   pixmap_ptr callback_tile_source::load(tile_key key)
+   {
+      return _load? _load(key) : pixmap_ptr{};
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // tiled_image implementation
+   ////////////////////////////////////////////////////////////////////////////
+   namespace
+   {
+      // The area of a tile, in pixels of its level
+      rect tile_rect(tile_source const& src, tile_key key)
+      {
+         auto size = src.level_size(key.level);
+         float ts = src.tile_size();
+         return {
+            key.col * ts, key.row * ts
+          , std::min((key.col + 1) * ts, size.x)
+          , std::min((key.row + 1) * ts, size.y)
+         };
+      }
+
+      std::size_t tile_bytes(pixmap const& pm)
+      {
+         auto s = pm.size();
+         auto scale = pm.scale();
+         return std::size_t(s.x / scale) * std::size_t(s.y / scale) * 4;
+      }
+   }
+
+   // State shared with the loaders. Tiles that failed to load are cached
+   // as nullptrs, so they are not requested again. wanted holds the tiles
+   // visible in the last draw. view_ and self tell the loaders what to
+   // refresh. self is reset when the element goes away.
+   struct tiled_image::state
+   {
+      struct entry
+      {
+         pixmap_ptr                          pm;
+         std::size_t                         bytes;
+         std::list<tile_key>::iterator       lru;
+      };
+
+      pixmap_ptr find(tile_key key, bool& found)
+      {
+         auto i = tiles.find(key);
+         found = i != tiles.end();
+         if (!found)
+            return {};
+         lru.splice(lru.begin(), lru, i->second.lru);
+         return i->second.pm;
+      }
+
+      void insert(tile_key key, pixmap_ptr pm)
+      {
+         if (tiles.count(key))
+            return;
+         auto bytes = pm? tile_bytes(*pm) : 0;
+         lru.push_front(key);
+         tiles[key] = entry{ pm, bytes, lru.begin() };
+         size += bytes;
+
+         // Evict the least recently used tiles, but never the one we just
+         // loaded
+         while (size > budget && lru.size() > 1)
+         {
+            auto i = tiles.find(lru.back());
+            size -= i->second.bytes;
+            tiles.erase(i);
+            lru.pop_back();
+         }
+      }
+
+      void clear()
+      {
+         tiles.clear();
+         lru.clear();
+         size = 0;
+      }
+
+      std::mutex                             mutex;
+      std::map<tile_key, entry>              tiles;
+      std::list<tile_key>                    lru;     // Most recently used first
+      std::size_t                            size = 0;
+      std::size_t                            budget = 0;
+      std::set<tile_key>                     pending;
+      std::set<tile_key>                     wanted;
+      weak_view                              view_;
+      element*                               self = nullptr;
+   };
+
+   tiled_image::tiled_image(
+      tile_source_ptr source, float scale, color placeholder, std::size_t cache_budget)
+    : _source(std::move(source))
+    , _scale(scale)
+    , _placeholder(placeholder)
+    , _state(std::make_shared<state>())
+   {
+      _state->budget = cache_budget;
+   }
+
+   tiled_image::~tiled_image()
+   {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      _state->self = nullptr;
+      _state->wanted.clear();
+   }
+
+   view_limits tiled_image::limits(basic_context const& /* ctx */) const
+   {
+      auto size = _source->size();
+      auto w = size.x * _scale;
+      auto h = size.y * _scale;
+      return { { w, h }, { w, h } };
+   }
+
+   int tiled_image::select_level(context const& ctx) const
+   {
+      // Pick the coarsest level that still has at least one pixel per
+      // device pixel
+      auto ds = detail::device_scale(ctx.canvas.cairo_context());
+      if (ds <= 0)
+         return 0;
+      auto pixels_per_source_pixel = ds * _scale;
+      if (pixels_per_source_pixel >= 1)
+         return 0;
+      int level = std::floor(std::log2(1 / pixels_per_source_pixel));
+      return std::min(level, _source->num_levels() - 1);
+   }
+
+   bool tiled_image::draw_tile(context const& ctx, tile_key key, rect dest)
+   {
+      auto& cnv = ctx.canvas;
+      auto const& src = *_source;
+
+      pixmap_ptr pm;
+      bool found;
+      {
+         std::lock_guard<std::mutex> lock(_state->mutex);
+         pm = _state->find(key, found);
+      }
+      if (pm)
+      {
+         cnv.draw(*pm, dest);
+         return true;
+      }
+
+      // Not there yet (or missing). Draw the part of the nearest cached
+      // coarser tile that covers it, if any.
+      auto tr = tile_rect(src, key);
+      for (int level = key.level + 1; level < src.num_levels(); ++level)
+      {
+         int shift = level - key.level;
+         auto parent = tile_key{ level, key.col >> shift, key.row >> shift };
+         bool parent_found;
+         pixmap_ptr parent_pm;
+         {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            parent_pm = _state->find(parent, parent_found);
+         }
+         if (parent_pm)
+         {
+            auto pr = tile_rect(src, parent);
+            auto div = float(1 << shift);
+            auto pm_size = parent_pm->size();
+            auto sx = pm_size.x / pr.width();
+            auto sy = pm_size.y / pr.height();
+            auto src_rect = rect{
+               (tr.left / div - pr.left) * sx
+             , (tr.top / div - pr.top) * sy
+             , (tr.right / div - pr.left) * sx
+             , (tr.bottom / div - pr.top) * sy
+            };
+            cnv.draw(*parent_pm, src_rect, dest);
+            return found;
+         }
+      }
+
+      cnv.fill_style(_placeholder);
+      cnv.fill_rect(dest);
+      return found;
+   }
+
+   void tiled_image::draw(context const& ctx)
+   {
+      auto& cnv = ctx.canvas;
+      auto visible = min(ctx.bounds, cnv.clip_extent());
+      if (visible.is_empty())
+         return;
+
+      auto const& src = *_source;
+      auto level = select_level(ctx);
+      auto tile_extent = src.tile_size() * float(1 << level) * _scale;
+      auto cols = src.num_cols(level);
+      auto rows = src.num_rows(level);
+
+      int col_first = std::max<int>(std::floor((visible.left - ctx.bounds.left) / tile_extent), 0);
+      int col_last = std::min<int>(std::ceil((visible.right - ctx.bounds.left) / tile_extent), cols);
+      int row_first = std::max<int>(std::floor((visible.top - ctx.bounds.top) / tile_extent), 0);
+      int row_last = std::min<int>(std::ceil((visible.bottom - ctx.bounds.top) / tile_extent), rows);
+
+      std::set<tile_key> wanted;
+      for (int row = row_first; row < row_last; ++row)
+         for (int col = col_first; col < col_last; ++col)
+            wanted.insert({ level, col, row });
+
+      {
+         std::lock_guard<std::mutex> lock(_state->mutex);
+         _state->wanted = wanted;
+         _state->view_ = ctx.view.get_weak_view();
+         _state->self = this;
+      }
+
+      for (auto key : wanted)
+      {
+         auto dest = rect{
+            ctx.bounds.left + key.col * tile_extent
+          , ctx.bounds.top + key.row * tile_extent
+          , std::min(ctx.bounds.left + (key.col + 1) * tile_extent, ctx.bounds.right)
+          , std::min(ctx.bounds.top + (key.row + 1) * tile_extent, ctx.bounds.bottom)
+         };
+
+         if (draw_tile(ctx, key, dest))
+            continue;
+
+         {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            if (!_state->pending.insert(key).second)
+               continue;
+         }
+
+         asio::post(worker_pool(),
+            [state_ = _state, source = _source, key]()
+            {
+               {
+                  // Skip tiles that scrolled out of view while queued
+                  std::lock_guard<std::mutex> lock(state_->mutex);
+                  if (!state_->wanted.count(key))
+                  {
+                     state_->pending.erase(key);
+                     return;
+                  }
+               }
+
+               pixmap_ptr pm;
+               try
+               {
+                  pm = source->load(key);
+               }
+               catch (failed_to_load_pixmap const&)
+               {
+               }
+
+               std::lock_guard<std::mutex> lock(state_->mutex);
+               state_->pending.erase(key);
+               state_->insert(key, pm);
+               if (pm && state_->self && state_->wanted.count(key))
+                  state_->view_.refresh(*state_->self);  // Posted to the UI thread
+            }
+         );
+      }
+   }
+
+   std::size_t tiled_image::cache_size() const
+   {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      return _state->size;
+   }
+
+   void tiled_image::clear_cache()
+   {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      _state->clear();
+   }
+}}
@@ -4,60 +4,294 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <elements/support/canvas.hpp>
+#include <elements/support/pixel_ops.hpp>
+#include <elements/support/detail/device_scale.hpp>
 #include <cairo.h>
 
-#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
 
 namespace cycfi { namespace elements
 {
    namespace
    {
-      struct cairo_pattern_deleter
+      void add_color_stops(cairo_pattern_t* pat, std::vector<canvas::color_stop> const& space)
       {
-         void operator()(cairo_pattern_t* pattern) const
+         for (auto cs : space)
          {
-            if (pattern)
-               cairo_pattern_destroy(pattern);
+            cairo_pattern_add_color_stop_rgba(
+               pat, cs.offset,
+               cs.color.red, cs.color.green, cs.color.blue, cs.color.alpha
+            );
          }
-      };
-
-      // use shared pointer instead of unique because std::function wants copyable types
-      using cairo_pattern_ptr = std::shared_ptr<cairo_pattern_t>;
+      }
 
-      cairo_pattern_ptr make_linear_pattern(canvas::linear_gradient const& gr)
+      cairo_pattern_t* make_linear_pattern(canvas::linear_gradient const& gr)
       {
          cairo_pattern_t* pat = cairo_pattern_create_linear(
             gr.start.x, gr.start.y, gr.end.x, gr.end.y
          );
+         add_color_stops(pat, gr.space);
+         return pat;
+      }
+
+      cairo_pattern_t* make_radial_pattern(canvas::radial_gradient const& gr)
+      {
+         cairo_pattern_t* pat = cairo_pattern_create_radial(
+            gr.c1.x, gr.c1.y, gr.c1_radius,
+            gr.c2.x, gr.c2.y, gr.c2_radius
+         );
+         add_color_stops(pat, gr.space);
+         return pat;
+      }
+
+      ////////////////////////////////////////////////////////////////////////
+      // gradient_cache: Gradients are cached by their geometry-independent
+      // definition: the color stops plus the gradient normalized to a unit
+      // space (a linear gradient from (0, 0) to (1, 0), or a radial
+      // gradient with the first circle at the origin and the second
+      // circle's radius 1). The actual position is applied per draw using
+      // the pattern matrix. Each thread has its own cache.
+      ////////////////////////////////////////////////////////////////////////
+      class gradient_cache
+      {
+      public:
+
+         enum type_enum { linear, radial };
+
+                              gradient_cache() = default;
+                              gradient_cache(gradient_cache const&) = delete;
+                              ~gradient_cache()       { clear(); }
+         gradient_cache&      operator=(gradient_cache const&) = delete;
+
+         // Returns a new reference to the cached pattern
+         cairo_pattern_t*     get(
+                                 type_enum type, point c, float r
+                               , std::vector<canvas::color_stop> const& space
+                              );
+
+      private:
+
+         static constexpr std::size_t max_size = 256;
 
-         for (auto cs : gr.space)
+         struct entry
          {
-            cairo_pattern_add_color_stop_rgba(
-               pat, cs.offset,
-               cs.color.red, cs.color.green, cs.color.blue, cs.color.alpha
+            type_enum                        type;
+            point                            c;
+            float                            r;
+            std::vector<canvas::color_stop>  space;
+            cairo_pattern_t*                 pattern;
+         };
+
+         void                 clear();
+
+         std::unordered_multimap<std::size_t, entry> _map;
+      };
+
+      void gradient_cache::clear()
+      {
+         for (auto& item : _map)
+            cairo_pattern_destroy(item.second.pattern);
+         _map.clear();
+      }
+
+      cairo_pattern_t* gradient_cache::get(
+         type_enum type, point c, float r
+       , std::vector<canvas::color_stop> const& space
+      )
+      {
+         // FNV-1a
+         std::uint64_t h = 14695981039346656037ull;
+         auto add = [&h](float val)
+         {
+            std::uint32_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            h = (h ^ bits) * 1099511628211ull;
+         };
+         add(float(type));
+         add(c.x);
+         add(c.y);
+         add(r);
+         for (auto const& cs : space)
+         {
+            add(cs.offset);
+            add(cs.color.red);
+            add(cs.color.green);
+            add(cs.color.blue);
+            add(cs.color.alpha);
+         }
+         auto hash = std::size_t(h);
+
+         auto same_stops = [&space](std::vector<canvas::color_stop> const& other)
+         {
+            return std::equal(space.begin(), space.end(), other.begin(), other.end(),
+               [](auto const& a, auto const& b)
+               {
+                  return a.offset == b.offset && a.color == b.color;
+               }
             );
+         };
+
+         auto range = _map.equal_range(hash);
+         for (auto i = range.first; i != range.second; ++i)
+         {
+            auto const& e = i->second;
+            if (e.type == type && e.c == c && e.r == r && same_stops(e.space))
+               return cairo_pattern_reference(e.pattern);
          }
 
-         return cairo_pattern_ptr(pat, cairo_pattern_deleter{});
+         // Live styles hold their own references, so we can simply start
+         // over when the cache gets too big.
+         if (_map.size() >= max_size)
+            clear();
+
+         cairo_pattern_t* pat = (type == linear)?
+            cairo_pattern_create_linear(0, 0, 1, 0) :
+            cairo_pattern_create_radial(0, 0, r, c.x, c.y, 1)
+            ;
+         add_color_stops(pat, space);
+         _map.emplace(hash, entry{ type, c, r, space, pat });
+         return cairo_pattern_reference(pat);
       }
 
-      cairo_pattern_ptr make_radial_pattern(canvas::radial_gradient const& gr)
+      gradient_cache& get_gradient_cache()
       {
-         cairo_pattern_t* pat = cairo_pattern_create_radial(
-            gr.c1.x, gr.c1.y, gr.c1_radius,
-            gr.c2.x, gr.c2.y, gr.c2_radius
+         thread_local gradient_cache cache;
+         return cache;
+      }
+
+      // Get the (possibly shared) pattern for gr and its pattern matrix
+      cairo_pattern_t* linear_pattern(canvas::linear_gradient const& gr, cairo_matrix_t& mat)
+      {
+         float dx = gr.end.x - gr.start.x;
+         float dy = gr.end.y - gr.start.y;
+         float len2 = (dx * dx) + (dy * dy);
+         if (len2 == 0)
+         {
+            cairo_matrix_init_identity(&mat);
+            return make_linear_pattern(gr);
+         }
+
+         // Map user space to the unit gradient space: the gradient vector
+         // maps to (1, 0).
+         float sx = gr.start.x;
+         float sy = gr.start.y;
+         cairo_matrix_init(&mat
+          , dx / len2, -dy / len2
+          , dy / len2, dx / len2
+          , -((dx * sx) + (dy * sy)) / len2
+          , ((dy * sx) - (dx * sy)) / len2
          );
 
-         for (auto cs : gr.space)
+         return get_gradient_cache().get(gradient_cache::linear, {}, 0, gr.space);
+      }
+
+      cairo_pattern_t* radial_pattern(canvas::radial_gradient const& gr, cairo_matrix_t& mat)
+      {
+         float r2 = gr.c2_radius;
+         if (r2 <= 0)
          {
-            cairo_pattern_add_color_stop_rgba(
-               pat, cs.offset,
-               cs.color.red, cs.color.green, cs.color.blue, cs.color.alpha
-            );
+            cairo_matrix_init_identity(&mat);
+            return make_radial_pattern(gr);
          }
 
-         return cairo_pattern_ptr(pat, cairo_pattern_deleter{});
+         // Map user space to the unit gradient space: the first circle is
+         // centered at the origin and the second circle has radius 1.
+         cairo_matrix_init(&mat, 1 / r2, 0, 0, 1 / r2, -gr.c1.x / r2, -gr.c1.y / r2);
+
+         point c = { (gr.c2.x - gr.c1.x) / r2, (gr.c2.y - gr.c1.y) / r2 };
+         return get_gradient_cache().get(gradient_cache::radial, c, gr.c1_radius / r2, gr.space);
+      }
+   }
+
+   canvas::style::style(color c)
+    : _kind(color_kind)
+    , _color(c)
+   {}
+
+   canvas::style::style(cairo_pattern_t* pattern, cairo_matrix_t const& mat)
+    : _kind(pattern_kind)
+    , _pattern(pattern)
+    , _matrix(mat)
+   {}
+
+   canvas::style::style(style const& rhs)
+    : _kind(rhs._kind)
+    , _color(rhs._color)
+    , _pattern(rhs._pattern? cairo_pattern_reference(rhs._pattern) : nullptr)
+    , _matrix(rhs._matrix)
+   {}
+
+   canvas::style::style(style&& rhs) noexcept
+    : _kind(rhs._kind)
+    , _color(rhs._color)
+    , _pattern(rhs._pattern)
+    , _matrix(rhs._matrix)
+   {
+      rhs._kind = none;
+      rhs._pattern = nullptr;
+   }
+
+   canvas::style::~style()
+   {
+      if (_pattern)
+         cairo_pattern_destroy(_pattern);
+   }
+
+   canvas::style& canvas::style::operator=(style const& rhs)
+   {
+      if (this != &rhs)
+      {
+         if (rhs._pattern)
+            cairo_pattern_reference(rhs._pattern);
+         if (_pattern)
+            cairo_pattern_destroy(_pattern);
+         _kind = rhs._kind;
+         _color = rhs._color;
+         _pattern = rhs._pattern;
+         _matrix = rhs._matrix;
       }
+      return *this;
+   }
+
+   canvas::style& canvas::style::operator=(style&& rhs) noexcept
+   {
+      std::swap(_kind, rhs._kind);
+      std::swap(_color, rhs._color);
+      std::swap(_pattern, rhs._pattern);
+      std::swap(_matrix, rhs._matrix);
+      return *this;
+   }
+
+   void canvas::style::apply(cairo_t& context_) const
+   {
+      switch (_kind)
+      {
+         case color_kind:
+            cairo_set_source_rgba(
+               &context_, _color.red, _color.green, _color.blue, _color.alpha);
+            break;
+         case pattern_kind:
+            update_matrix();
+            cairo_set_source(&context_, _pattern);
+            break;
+         default:
+            break;
+      }
+   }
+
+   void canvas::style::update_matrix() const
+   {
+      // Patterns may be shared (see gradient_cache) by other canvases on
+      // this thread (e.g. a static_layer or pixmap_context canvas), and
+      // cairo reads the matrix when filling or stroking. So we set it
+      // before every fill and stroke, even if the source is already set.
+      if (_kind == pattern_kind)
+         cairo_pattern_set_matrix(_pattern, &_matrix);
    }
 
    canvas::canvas(cairo_t& context_)
@@ -75,16 +309,22 @@ namespace cycfi { namespace elements
    void canvas::translate(point p)
    {
       cairo_translate(&_context, p.x, p.y);
+      if (_path_kind != path_empty)
+         _path_kind = path_complex;
    }
 
    void canvas::rotate(float rad)
    {
       cairo_rotate(&_context, rad);
+      if (_path_kind != path_empty)
+         _path_kind = path_complex;
    }
 
    void canvas::scale(point p)
    {
       cairo_scale(&_context, p.x, p.y);
+      if (_path_kind != path_empty)
+         _path_kind = path_complex;
    }
 
    point canvas::device_to_user(point p)
@@ -103,20 +343,189 @@ namespace cycfi { namespace elements
       return { float(x), float(y) };
    }
 
+   namespace
+   {
+      // Map user space to target pixels. Returns false if user space is
+      // rotated or skewed, or the target is not an (A)RGB image surface.
+      struct pixel_mapping
+      {
+         bool init(cairo_t& context_)
+         {
+            target = cairo_get_group_target(&context_);
+            if (cairo_surface_get_type(target) != CAIRO_SURFACE_TYPE_IMAGE)
+               return false;
+            auto format = cairo_image_surface_get_format(target);
+            if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24)
+               return false;
+
+            cairo_get_matrix(&context_, &mat);
+            if (mat.xy != 0 || mat.yx != 0)
+               return false;
+
+            double sx, sy, ox, oy;
+            cairo_surface_get_device_scale(target, &sx, &sy);
+            cairo_surface_get_device_offset(target, &ox, &oy);
+            mat.xx *= sx;
+            mat.x0 = mat.x0 * sx + ox;
+            mat.yy *= sy;
+            mat.y0 = mat.y0 * sy + oy;
+            return true;
+         }
+
+         // Snap x to an integer, if it is (very nearly) on one
+         static bool snap(double x, int& result)
+         {
+            auto r = std::round(x);
+            result = int(r);
+            return std::abs(x - r) < 1.0 / 256;
+         }
+
+         bool map(double x, double y, int& px, int& py) const
+         {
+            return snap(x * mat.xx + mat.x0, px) && snap(y * mat.yy + mat.y0, py);
+         }
+
+         cairo_surface_t*  target;
+         cairo_matrix_t    mat;
+      };
+   }
+
+   // Update the pixel clip rects. Returns false if the clip is not a set of
+   // pixel aligned rectangles.
+   bool canvas::update_pixel_clip()
+   {
+      if (_clip_kind == clip_unknown)
+      {
+         _clip_kind = clip_other;
+         _clip_rects.clear();
+
+         pixel_mapping mapping;
+         if (!mapping.init(_context))
+            return false;
+
+         // There is no way to tell "no clip" from a clip that cannot be
+         // represented as rectangles. Both take the slow path.
+         auto list = cairo_copy_clip_rectangle_list(&_context);
+         if (list->status == CAIRO_STATUS_SUCCESS)
+         {
+            bool aligned = true;
+            for (int i = 0; aligned && i != list->num_rectangles; ++i)
+            {
+               auto const& r = list->rectangles[i];
+               pixel_rect pr;
+               aligned =
+                  mapping.map(r.x, r.y, pr.left, pr.top) &&
+                  mapping.map(r.x + r.width, r.y + r.height, pr.right, pr.bottom);
+               if (pr.left > pr.right)
+                  std::swap(pr.left, pr.right);
+               if (pr.top > pr.bottom)
+                  std::swap(pr.top, pr.bottom);
+               _clip_rects.push_back(pr);
+            }
+            if (aligned)
+               _clip_kind = clip_pixels;
+            else
+               _clip_rects.clear();
+         }
+         cairo_rectangle_list_destroy(list);
+      }
+      return _clip_kind == clip_pixels;
+   }
+
+   // Fast path: fill a solid rect that is aligned to the target's pixels by
+   // writing spans directly into the target image surface. This bypasses
+   // cairo's general rasterizer. Returns false if the fast path does not
+   // apply; otherwise, the rect is drawn and the path cleared.
+   bool canvas::fill_pixel_rect(elements::rect r, color c)
+   {
+      if (cairo_get_operator(&_context) != CAIRO_OPERATOR_OVER)
+         return false;
+
+      // Sanity check: the current point is where cairo_rectangle or
+      // line_to leaves it
+      double cx, cy;
+      cairo_get_current_point(&_context, &cx, &cy);
+      auto expected = (_path_kind == path_rect)?
+         _path_rect.top_left() : _path_rect.bottom_right();
+      if (std::abs(cx - expected.x) > 1.0 / 128 || std::abs(cy - expected.y) > 1.0 / 128)
+         return false;
+
+      pixel_mapping mapping;
+      pixel_rect pr;
+      if (!mapping.init(_context)
+         || !mapping.map(r.left, r.top, pr.left, pr.top)
+         || !mapping.map(r.right, r.bottom, pr.right, pr.bottom)
+         || !update_pixel_clip())
+         return false;
+
+      if (pr.left > pr.right)
+         std::swap(pr.left, pr.right);
+      if (pr.top > pr.bottom)
+         std::swap(pr.top, pr.bottom);
+
+      auto target = mapping.target;
+      auto pixel = premultiplied_pixel(c);
+      if (cairo_image_surface_get_format(target) == CAIRO_FORMAT_RGB24)
+      {
+         if ((pixel >> 24) != 0xFF)
+            return false;
+      }
+
+      cairo_surface_flush(target);
+      auto data = cairo_image_surface_get_data(target);
+      auto stride = cairo_image_surface_get_stride(target);
+      auto width = cairo_image_surface_get_width(target);
+      auto height = cairo_image_surface_get_height(target);
+      if (!data)
+         return false;
+
+      bool dirty = false;
+      for (auto const& clip : _clip_rects)
+      {
+         int left = std::max({ pr.left, clip.left, 0 });
+         int top = std::max({ pr.top, clip.top, 0 });
+         int right = std::min({ pr.right, clip.right, width });
+         int bottom = std::min({ pr.bottom, clip.bottom, height });
+         for (int y = top; y < bottom; ++y)
+         {
+            auto row = reinterpret_cast<uint32_t*>(data + y * stride);
+            fill_span(row + left, right - left, pixel);
+            dirty = true;
+         }
+      }
+      if (dirty)
+         cairo_surface_mark_dirty(target);
+
+      cairo_new_path(&_context);
+      _path_kind = path_empty;
+      return true;
+   }
+
    void canvas::begin_path()
    {
       cairo_new_path(&_context);
+      _path_kind = path_empty;
    }
 
    void canvas::close_path()
    {
       cairo_close_path(&_context);
+      _path_kind = path_complex;
    }
 
    void canvas::fill()
    {
+      if (_path_kind == path_rect)
+      {
+         if (auto c = _state.fill_style.solid_color())
+         {
+            if (fill_pixel_rect(_path_rect, *c))
+               return;
+         }
+      }
       apply_fill_style();
       cairo_fill(&_context);
+      _path_kind = path_empty;
    }
 
    void canvas::fill_preserve()
@@ -127,8 +536,33 @@ namespace cycfi { namespace elements
 
    void canvas::stroke()
    {
+      if (_path_kind == path_line)
+      {
+         auto c = _state.stroke_style.solid_color();
+         auto p1 = _path_rect.top_left();
+         auto p2 = _path_rect.bottom_right();
+         if (c && (p1.x == p2.x || p1.y == p2.y) && p1 != p2
+            && cairo_get_line_cap(&_context) == CAIRO_LINE_CAP_BUTT
+            && cairo_get_dash_count(&_context) == 0)
+         {
+            // A horizontal or vertical line with butt caps covers a rect
+            float half_w = cairo_get_line_width(&_context) / 2;
+            auto r = elements::rect{
+               std::min(p1.x, p2.x), std::min(p1.y, p2.y)
+             , std::max(p1.x, p2.x), std::max(p1.y, p2.y)
+            };
+            if (p1.y == p2.y)
+               r = r.inset(0, -half_w);
+            else
+               r = r.inset(-half_w, 0);
+
+            if (fill_pixel_rect(r, *c))
+               return;
+         }
+      }
       apply_stroke_style();
       cairo_stroke(&_context);
+      _path_kind = path_empty;
    }
 
    void canvas::stroke_preserve()
@@ -140,6 +574,8 @@ namespace cycfi { namespace elements
    void canvas::clip()
    {
       cairo_clip(&_context);
+      _path_kind = path_empty;
+      _clip_kind = clip_unknown;
    }
 
    bool canvas::hit_test(point p) const
@@ -154,14 +590,40 @@ namespace cycfi { namespace elements
       return elements::rect(x1, y1, x2, y2);
    }
 
+   rect canvas::clip_extent() const
+   {
+      double x1, y1, x2, y2;
+      cairo_clip_extents(&_context, &x1, &y1, &x2, &y2);
+      return elements::rect(x1, y1, x2, y2);
+   }
+
    void canvas::move_to(point p)
    {
       cairo_move_to(&_context, p.x, p.y);
+      if (_path_kind == path_empty)
+      {
+         _path_kind = path_moved;
+         _path_rect = { p.x, p.y, p.x, p.y };
+      }
+      else
+      {
+         _path_kind = path_complex;
+      }
    }
 
    void canvas::line_to(point p)
    {
       cairo_line_to(&_context, p.x, p.y);
+      if (_path_kind == path_moved)
+      {
+         _path_kind = path_line;
+         _path_rect.right = p.x;
+         _path_rect.bottom = p.y;
+      }
+      else
+      {
+         _path_kind = path_complex;
+      }
    }
 
    void canvas::arc_to(point /* p1 */, point /* p2 */, float /* radius */)
@@ -179,11 +641,21 @@ namespace cycfi { namespace elements
          cairo_arc_negative(&_context, p.x, p.y, radius, start_angle, end_angle);
       else
          cairo_arc(&_context, p.x, p.y, radius, start_angle, end_angle);
+      _path_kind = path_complex;
    }
 
    void canvas::rect(struct rect r)
    {
       cairo_rectangle(&_context, r.left, r.top, r.width(), r.height());
+      if (_path_kind == path_empty)
+      {
+         _path_kind = path_rect;
+         _path_rect = r;
+      }
+      else
+      {
+         _path_kind = path_complex;
+      }
    }
 
    void canvas::round_rect(struct rect bounds, float radius)
@@ -201,24 +673,19 @@ namespace cycfi { namespace elements
       cairo_arc(&_context, x+radius, b-radius, radius, 90*a, 180*a);
       cairo_arc(&_context, x+radius, y+radius, radius, 180*a, 270*a);
       cairo_close_path(&_context);
+      _path_kind = path_complex;
    }
 
    void canvas::fill_style(color c)
    {
-      _state.fill_style = [this, c]()
-      {
-         cairo_set_source_rgba(&_context, c.red, c.green, c.blue, c.alpha);
-      };
+      _state.fill_style = style{ c };
       if (_state.pattern_set == _state.fill_set)
          _state.pattern_set = _state.none_set;
    }
 
    void canvas::stroke_style(color c)
    {
-      _state.stroke_style = [this, c]()
-      {
-         cairo_set_source_rgba(&_context, c.red, c.green, c.blue, c.alpha);
-      };
+      _state.stroke_style = style{ c };
       if (_state.pattern_set == _state.stroke_set)
          _state.pattern_set = _state.none_set;
    }
@@ -230,20 +697,18 @@ namespace cycfi { namespace elements
 
    void canvas::fill_style(linear_gradient const& gr)
    {
-      _state.fill_style = [this, pat = make_linear_pattern(gr)]()
-      {
-         cairo_set_source(&_context, pat.get());
-      };
+      cairo_matrix_t mat;
+      auto pat = linear_pattern(gr, mat);
+      _state.fill_style = style{ pat, mat };
       if (_state.pattern_set == _state.fill_set)
          _state.pattern_set = _state.none_set;
    }
 
    void canvas::fill_style(radial_gradient const& gr)
    {
-      _state.fill_style = [this, pat = make_radial_pattern(gr)]()
-      {
-         cairo_set_source(&_context, pat.get());
-      };
+      cairo_matrix_t mat;
+      auto pat = radial_pattern(gr, mat);
+      _state.fill_style = style{ pat, mat };
       if (_state.pattern_set == _state.fill_set)
          _state.pattern_set = _state.none_set;
    }
@@ -321,6 +786,7 @@ namespace cycfi { namespace elements
       p = get_text_start(_context, p, _state.align, utf8);
       cairo_move_to(&_context, p.x, p.y);
       cairo_show_text(&_context, utf8);
+      _path_kind = path_complex;
    }
 
    void canvas::stroke_text(point p, char const* utf8)
@@ -329,6 +795,7 @@ namespace cycfi { namespace elements
       p = get_text_start(_context, p, _state.align, utf8);
       cairo_move_to(&_context, p.x, p.y);
       cairo_text_path(&_context, utf8);
+      _path_kind = path_complex;
       stroke();
    }
 
@@ -353,25 +820,68 @@ namespace cycfi { namespace elements
       auto  state = new_state();
       auto  w = dest.width();
       auto  h = dest.height();
+      auto  scale_ = point{ w/src.width(), h/src.height() };
+
+      // When drawn at less than half size, draw a downscaled variant
+      // instead, which cairo then scales down by no more than half.
+      auto  device_scale = detail::device_scale(_context);
+      auto  surface = pm.variant(
+         std::min(scale_.x, scale_.y) * device_scale * pm.scale(), src);
+
       translate(dest.top_left());
-      auto scale_ = point{ w/src.width(), h/src.height() };
       scale(scale_);
-      cairo_set_source_surface(&_context, pm._surface, -src.left, -src.top);
+      cairo_set_source_surface(&_context, surface, -src.left, -src.top);
+      cairo_surface_destroy(surface);
       rect({ 0, 0, w/scale_.x, h/scale_.y });
       cairo_fill(&_context);
+      _path_kind = path_empty;
    }
 
    void canvas::save()
    {
       cairo_save(&_context);
-      _state_stack.push(_state);
+      if (_state_depth < inline_stack_size)
+         _state_stack[_state_depth] = _state;
+      else
+         _overflow_stack.push_back(_state);
+      ++_state_depth;
    }
 
    void canvas::restore()
    {
-      _state = _state_stack.top();
-      _state_stack.pop();
+      assert(_state_depth > 0);
+      --_state_depth;
+      if (_state_depth < inline_stack_size)
+      {
+         _state = std::move(_state_stack[_state_depth]);
+      }
+      else
+      {
+         _state = std::move(_overflow_stack.back());
+         _overflow_stack.pop_back();
+      }
+
+      // Shared patterns may have had their matrix changed since the style
+      // was applied, so force the style to be applied again.
+      _state.pattern_set = _state.none_set;
       cairo_restore(&_context);
+      if (_path_kind != path_empty)
+         _path_kind = path_complex;
+      _clip_kind = clip_unknown;
    }
-}}
 
+   void canvas::reduced_quality(bool reduce)
+   {
+      _reduced_quality = reduce;
+      cairo_set_antialias(&_context, reduce? CAIRO_ANTIALIAS_FAST : CAIRO_ANTIALIAS_DEFAULT);
+
+      auto options = cairo_font_options_create();
+      cairo_get_font_options(&_context, options);
+      cairo_font_options_set_hint_style(
+         options, reduce? CAIRO_HINT_STYLE_NONE : CAIRO_HINT_STYLE_DEFAULT);
+      cairo_font_options_set_hint_metrics(
+         options, reduce? CAIRO_HINT_METRICS_OFF : CAIRO_HINT_METRICS_DEFAULT);
+      cairo_set_font_options(&_context, options);
+      cairo_font_options_destroy(options);
+   }
+}}
@@ -0,0 +1,168 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <elements/support/display_list.hpp>
+#include <cairo.h>
+#if CAIRO_HAS_SCRIPT_SURFACE
+# include <cairo-script.h>
+#endif
+#include <utility>
+
+namespace cycfi { namespace elements
+{
+   display_list::display_list(display_list const& rhs)
+    : _surface(rhs._surface ? cairo_surface_reference(rhs._surface) : nullptr)
+   {
+   }
+
+   display_list::display_list(display_list&& rhs) noexcept
+    : _surface(rhs._surface)
+    , _recorder(rhs._recorder)
+   {
+      rhs._surface = nullptr;
+      rhs._recorder = nullptr;
+   }
+
+   display_list::~display_list()
+   {
+      clear();
+   }
+
+   display_list& display_list::operator=(display_list const& rhs)
+   {
+      if (this != &rhs)
+      {
+         clear();
+         _surface = rhs._surface ? cairo_surface_reference(rhs._surface) : nullptr;
+      }
+      return *this;
+   }
+
+   display_list& display_list::operator=(display_list&& rhs) noexcept
+   {
+      if (this != &rhs)
+      {
+         std::swap(_surface, rhs._surface);
+         std::swap(_recorder, rhs._recorder);
+      }
+      return *this;
+   }
+
+   void display_list::clear()
+   {
+      if (_recorder)
+         cairo_destroy(_recorder);
+      if (_surface)
+         cairo_surface_destroy(_surface);
+      _recorder = nullptr;
+      _surface = nullptr;
+   }
+
+   cairo_t& display_list::begin_recording(float scale)
+   {
+      clear();
+
+      // An unbounded recording surface: user space is the same as the
+      // recorder's canvas. The device scale is picked up by drawing that
+      // rasterizes (see detail::device_scale), and undone on replay.
+      _surface = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, nullptr);
+      cairo_surface_set_device_scale(_surface, scale, scale);
+      _recorder = cairo_create(_surface);
+      return *_recorder;
+   }
+
+   void display_list::end_recording()
+   {
+      cairo_destroy(_recorder);
+      _recorder = nullptr;
+      cairo_surface_flush(_surface);
+   }
+
+   void display_list::replay(canvas& cnv) const
+   {
+      if (!_surface)
+         return;
+
+      auto& cr = cnv.cairo_context();
+      cairo_save(&cr);
+      cairo_set_source_surface(&cr, _surface, 0, 0);
+      cairo_paint(&cr);
+      cairo_restore(&cr);
+   }
+
+   display_list display_list::clone() const
+   {
+      display_list copy;
+      if (!_surface)
+         return copy;
+
+      // Recording surfaces snapshot their sources, so this copies the
+      // commands. Only the (immutable) image data is shared.
+      double sx, sy;
+      cairo_surface_get_device_scale(_surface, &sx, &sy);
+      copy.record([this](canvas& cnv) { replay(cnv); }, sx);
+      return copy;
+   }
+
+   rect display_list::extents() const
+   {
+      if (!_surface)
+         return {};
+
+      double x, y, w, h;
+      cairo_recording_surface_ink_extents(_surface, &x, &y, &w, &h);
+      return { float(x), float(y), float(x + w), float(y + h) };
+   }
+
+   namespace
+   {
+      rect union_extents(rect a, rect b)
+      {
+         if (a.width() <= 0 || a.height() <= 0)
+            return b;
+         if (b.width() <= 0 || b.height() <= 0)
+            return a;
+         return max(a, b);
+      }
+   }
+
+   rect display_list::diff(display_list const& prev) const
+   {
+      if (_surface == prev._surface)
+         return {};
+
+      auto ext = extents();
+      auto prev_ext = prev.extents();
+      if (ext != prev_ext)
+         return union_extents(ext, prev_ext);
+
+      auto script = serialize();
+      if (script.empty() || script != prev.serialize())
+         return union_extents(ext, prev_ext);
+      return {};
+   }
+
+   std::string display_list::serialize() const
+   {
+      std::string result;
+#if CAIRO_HAS_SCRIPT_SURFACE
+      if (!_surface)
+         return result;
+
+      auto write = [](void* closure, unsigned char const* data, unsigned int length)
+      {
+         static_cast<std::string*>(closure)->append(
+            reinterpret_cast<char const*>(data), length);
+         return CAIRO_STATUS_SUCCESS;
+      };
+
+      auto script = cairo_script_create_for_stream(write, &result);
+      cairo_script_from_recording_surface(script, _surface);
+      cairo_device_finish(script);
+      cairo_device_destroy(script);
+#endif
+      return result;
+   }
+}}
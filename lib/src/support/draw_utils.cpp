@@ -5,6 +5,15 @@
 =============================================================================*/
 #include <elements/support/draw_utils.hpp>
 #include <elements/support/theme.hpp>
+#include <elements/support/detail/device_scale.hpp>
+#include <elements/support/pixel_ops.hpp>
+#include <cairo.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <tuple>
 
 namespace cycfi { namespace elements
 {
@@ -31,15 +40,11 @@ namespace cycfi { namespace elements
       cnv.stroke();
    }
 
-   void draw_panel(canvas& cnv, rect bounds, color c, float corner_radius)
+   namespace
    {
-      // Panel fill
-      cnv.begin_path();
-      cnv.round_rect(bounds, corner_radius);
-      cnv.fill_style(c);
-      cnv.fill();
-
-      // Simulated blurred shadow. cairo does not have blur yet :-(
+      // Simulated blurred shadow, used when the canvas is rotated or skewed
+      // or the shape is too small for the nine-slice shadow image.
+      void draw_simulated_shadow(canvas& cnv, rect bounds, float corner_radius)
       {
          auto save = cnv.new_state();
 
@@ -77,28 +82,264 @@ namespace cycfi { namespace elements
          cnv.fill_style(rgba(0, 0, 0, 40));
          cnv.fill();
       }
+
+      ////////////////////////////////////////////////////////////////////////
+      // Soft shadows are nine-slice images: a blurred round-rect with the
+      // shape itself punched out. The corners are blitted 1:1 and the one
+      // pixel middle row and column are stretched to fit the shape.
+      ////////////////////////////////////////////////////////////////////////
+      struct shadow_image
+      {
+         cairo_pattern_t*  pattern = nullptr;
+         int               pad = 0;       // Shadow extent outside the shape
+         int               corner = 0;    // Non-uniform extent inside the shape
+         int               size = 0;      // Width and height of the image
+      };
+
+      shadow_image make_shadow(float radius, int blur, point offset, color c)
+      {
+         shadow_image img;
+         int ox = std::lround(offset.x);
+         int oy = std::lround(offset.y);
+         int max_offset = std::max(std::abs(ox), std::abs(oy));
+         img.pad = 3 * blur + max_offset;
+         img.corner = int(std::ceil(radius)) + 3 * blur + max_offset + 1;
+         img.size = 2 * (img.pad + img.corner) + 1;
+
+         auto shape = rect{
+            float(img.pad), float(img.pad)
+          , float(img.size - img.pad), float(img.size - img.pad)
+         };
+
+         // Render the shape's alpha, offset
+         auto n = img.size;
+         auto mask = cairo_image_surface_create(CAIRO_FORMAT_A8, n, n);
+         {
+            auto cr = cairo_create(mask);
+            {
+               canvas cnv{ *cr };
+               cnv.begin_path();
+               cnv.round_rect(shape.move(ox, oy), radius);
+               cnv.fill_style(colors::black);
+               cnv.fill();
+            }
+            cairo_destroy(cr);
+            cairo_surface_flush(mask);
+         }
+         auto alpha = cairo_image_surface_get_data(mask);
+         auto alpha_stride = cairo_image_surface_get_stride(mask);
+
+         // Three box blur passes approximate a gaussian blur
+         for (int i = 0; i != 3; ++i)
+            box_blur(alpha, n, n, alpha_stride, blur);
+
+         // Colorize (cairo wants premultiplied alpha)
+         auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, n, n);
+         {
+            auto data = cairo_image_surface_get_data(surface);
+            auto stride = cairo_image_surface_get_stride(surface);
+            for (int y = 0; y != n; ++y)
+            {
+               auto row = reinterpret_cast<uint32_t*>(data + y * stride);
+               for (int x = 0; x != n; ++x)
+               {
+                  float a = alpha[y * alpha_stride + x] / 255.0f * c.alpha;
+                  row[x] =
+                       (uint32_t(a * 255 + 0.5f) << 24)
+                     | (uint32_t(c.red * a * 255 + 0.5f) << 16)
+                     | (uint32_t(c.green * a * 255 + 0.5f) << 8)
+                     | uint32_t(c.blue * a * 255 + 0.5f)
+                     ;
+               }
+            }
+            cairo_surface_mark_dirty(surface);
+         }
+         cairo_surface_destroy(mask);
+
+         // Punch out the shape, exactly. Its antialiased edge is partly
+         // cleared, matching the coverage of the shape drawn over it.
+         {
+            auto cr = cairo_create(surface);
+            {
+               canvas cnv{ *cr };
+               cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+               cnv.begin_path();
+               cnv.round_rect(shape, radius);
+               cnv.fill();
+            }
+            cairo_destroy(cr);
+         }
+
+         img.pattern = cairo_pattern_create_for_surface(surface);
+         cairo_surface_destroy(surface);
+         cairo_pattern_set_filter(img.pattern, CAIRO_FILTER_NEAREST);
+         cairo_pattern_set_extend(img.pattern, CAIRO_EXTEND_PAD);
+         return img;
+      }
+
+      class shadow_cache
+      {
+      public:
+
+         static constexpr std::size_t max_entries = 64;
+
+         ~shadow_cache()
+         {
+            clear();
+         }
+
+         shadow_image const& get(float radius, int blur, point offset, color c)
+         {
+            auto key = std::make_tuple(
+               radius, blur, offset.x, offset.y
+             , c.red, c.green, c.blue, c.alpha
+            );
+            auto i = _map.find(key);
+            if (i == _map.end())
+            {
+               if (_map.size() == max_entries)
+                  clear();
+               i = _map.emplace(key, make_shadow(radius, blur, offset, c)).first;
+            }
+            return i->second;
+         }
+
+      private:
+
+         void clear()
+         {
+            for (auto& entry : _map)
+               cairo_pattern_destroy(entry.second.pattern);
+            _map.clear();
+         }
+
+         using key_type = std::tuple<
+            float, int, float, float, float, float, float, float>;
+
+         std::map<key_type, shadow_image> _map;
+      };
+
+      shadow_cache& get_shadow_cache()
+      {
+         thread_local shadow_cache cache;
+         return cache;
+      }
    }
 
-   void draw_button(canvas& cnv, rect bounds, color c, float corner_radius)
+   void draw_shadow(
+      canvas& cnv, rect bounds, float corner_radius
+    , float blur, point offset, color c)
    {
-      auto gradient = canvas::linear_gradient{
-         bounds.top_left(),
-         bounds.bottom_left()
-      };
+      auto& cr = cnv.cairo_context();
+      auto scale = detail::device_scale(cr);
+      if (scale <= 0)
+      {
+         draw_simulated_shadow(cnv, bounds, corner_radius);
+         return;
+      }
 
-      float const box_opacity = get_theme().element_background_opacity;
-      gradient.add_color_stop({ 0.0, rgb(255, 255, 255).opacity(box_opacity) });
-      gradient.add_color_stop({ 1.0, rgb(0, 0, 0).opacity(box_opacity) });
-      cnv.fill_style(gradient);
+      // Everything below is in device pixels
+      int box_radius = std::max(1, int(std::lround(blur * scale / 3)));
+      auto const& img = get_shadow_cache().get(
+         corner_radius * scale, box_radius
+       , point{ float(std::lround(offset.x * scale)), float(std::lround(offset.y * scale)) }
+       , c
+      );
+
+      int w = std::lround(bounds.width() * scale);
+      int h = std::lround(bounds.height() * scale);
+      int min_size = 2 * img.corner + 1;
+      if (w < min_size || h < min_size)
+      {
+         draw_simulated_shadow(cnv, bounds, corner_radius);
+         return;
+      }
+
+      // Snap the origin to device pixels so the corners are blitted 1:1
+      double x = bounds.left;
+      double y = bounds.top;
+      cairo_user_to_device(&cr, &x, &y);
+      x = std::round(x);
+      y = std::round(y);
+      cairo_device_to_user(&cr, &x, &y);
+
+      cairo_save(&cr);
+      cairo_translate(&cr, x, y);
+      cairo_scale(&cr, 1/scale, 1/scale);
+      cairo_new_path(&cr);
+      cairo_set_source(&cr, img.pattern);
+
+      int const mid = img.pad + img.corner;
+      int const src_x[] = { 0, mid, mid + 1, img.size };
+      int const src_y[] = { 0, mid, mid + 1, img.size };
+      int const dest_x[] = { -img.pad, img.corner, w - img.corner, w + img.pad };
+      int const dest_y[] = { -img.pad, img.corner, h - img.corner, h + img.pad };
+
+      for (int j = 0; j != 3; ++j)
+      {
+         for (int i = 0; i != 3; ++i)
+         {
+            // The middle slice is inside the shape and fully transparent
+            if (i == 1 && j == 1)
+               continue;
+
+            double sw = src_x[i+1] - src_x[i];
+            double sh = src_y[j+1] - src_y[j];
+            double dw = dest_x[i+1] - dest_x[i];
+            double dh = dest_y[j+1] - dest_y[j];
+            if (dw <= 0 || dh <= 0)
+               continue;
+
+            cairo_matrix_t mat;
+            cairo_matrix_init_translate(&mat, src_x[i], src_y[j]);
+            cairo_matrix_scale(&mat, sw / dw, sh / dh);
+            cairo_matrix_translate(&mat, -dest_x[i], -dest_y[j]);
+            cairo_pattern_set_matrix(img.pattern, &mat);
+
+            cairo_rectangle(&cr, dest_x[i], dest_y[j], dw, dh);
+            cairo_fill(&cr);
+         }
+      }
+      cairo_restore(&cr);
+   }
 
+   void draw_panel(canvas& cnv, rect bounds, color c, float corner_radius)
+   {
+      // Panel fill
       cnv.begin_path();
-      cnv.round_rect(bounds.inset(1, 1), corner_radius-1);
+      cnv.round_rect(bounds, corner_radius);
       cnv.fill_style(c);
       cnv.fill();
+
+      // Soft shadow (skipped while interacting)
+      if (!cnv.reduced_quality())
+         draw_shadow(cnv, bounds, corner_radius, 6, { 2, 2 }, rgba(0, 0, 0, 90));
+   }
+
+   void draw_button(canvas& cnv, rect bounds, color c, float corner_radius)
+   {
+      cnv.begin_path();
       cnv.round_rect(bounds.inset(1, 1), corner_radius-1);
-      cnv.fill_style(gradient);
+      cnv.fill_style(c);
       cnv.fill();
 
+      // Gradient overlay (skipped while interacting)
+      if (!cnv.reduced_quality())
+      {
+         auto gradient = canvas::linear_gradient{
+            bounds.top_left(),
+            bounds.bottom_left()
+         };
+
+         float const box_opacity = get_theme().element_background_opacity;
+         gradient.add_color_stop({ 0.0, rgb(255, 255, 255).opacity(box_opacity) });
+         gradient.add_color_stop({ 1.0, rgb(0, 0, 0).opacity(box_opacity) });
+
+         cnv.round_rect(bounds.inset(1, 1), corner_radius-1);
+         cnv.fill_style(gradient);
+         cnv.fill();
+      }
+
       cnv.begin_path();
       cnv.round_rect(bounds.inset(0.5, 0.5), corner_radius-0.5);
       cnv.stroke_style(rgba(0, 0, 0, 48));
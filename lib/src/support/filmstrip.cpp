@@ -0,0 +1,371 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <elements/support/filmstrip.hpp>
+#include <elements/support/resource_paths.hpp>
+#include <elements/support/pixel_ops.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace cycfi { namespace elements
+{
+   namespace
+   {
+      constexpr std::size_t key_interval = 16;
+
+      // Frames are stored as runs of 32 bit words. Each run starts with a
+      // header word, (count << 1) | literal. A literal run is followed by
+      // its count words; a repeat run by the single word that repeats.
+      void encode(uint32_t const* p, std::size_t n, std::vector<uint32_t>& out)
+      {
+         std::size_t literal_start = 0;
+         auto flush_literals = [&](std::size_t end)
+         {
+            if (end > literal_start)
+            {
+               out.push_back(uint32_t(((end - literal_start) << 1) | 1));
+               out.insert(out.end(), p + literal_start, p + end);
+            }
+         };
+
+         for (std::size_t i = 0; i < n;)
+         {
+            std::size_t j = i + 1;
+            while (j < n && p[j] == p[i])
+               ++j;
+            if (j - i >= 3)
+            {
+               flush_literals(i);
+               out.push_back(uint32_t((j - i) << 1));
+               out.push_back(p[i]);
+               literal_start = j;
+            }
+            i = j;
+         }
+         flush_literals(n);
+      }
+
+      void decode_key(uint32_t const* in, uint32_t const* end, uint32_t* p)
+      {
+         while (in != end)
+         {
+            auto count = *in >> 1;
+            if (*in++ & 1)
+            {
+               std::copy(in, in + count, p);
+               in += count;
+            }
+            else
+            {
+               std::fill_n(p, count, *in++);
+            }
+            p += count;
+         }
+      }
+
+      // Deltas are xor-ed, so the same delta steps both ways: from the
+      // previous frame to its frame, and back.
+      void apply_delta(uint32_t const* in, uint32_t const* end, uint32_t* p)
+      {
+         while (in != end)
+         {
+            auto count = *in >> 1;
+            if (*in++ & 1)
+            {
+               for (std::size_t i = 0; i != count; ++i)
+                  p[i] ^= in[i];
+               in += count;
+            }
+            else if (auto val = *in++)
+            {
+               for (std::size_t i = 0; i != count; ++i)
+                  p[i] ^= val;
+            }
+            p += count;
+         }
+      }
+   }
+
+   struct compressed_filmstrip::data
+   {
+      struct range
+      {
+         std::size_t          begin, end;
+      };
+
+                              data(cairo_surface_t* strip, float frame_height);
+
+      int                     width = 0;     // frame size in pixels
+      int                     height = 0;
+      float                   scale = 1;
+      std::size_t             num_frames = 0;
+      std::vector<uint32_t>   words;
+      std::vector<range>      deltas;        // one per frame
+      std::vector<range>      keys;          // one per key_interval frames
+   };
+
+   compressed_filmstrip::data::data(cairo_surface_t* strip, float frame_height)
+   {
+      // Work on native ARGB32 pixels
+      auto format = cairo_image_surface_get_format(strip);
+      auto sw = cairo_image_surface_get_width(strip);
+      auto sh = cairo_image_surface_get_height(strip);
+      cairo_surface_t* argb = nullptr;
+      if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24)
+      {
+         argb = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, sw, sh);
+         auto cr = cairo_create(argb);
+         cairo_set_source_surface(cr, strip, 0, 0);
+         cairo_paint(cr);
+         cairo_destroy(cr);
+         strip = argb;
+      }
+      cairo_surface_flush(strip);
+
+      double scx, scy;
+      cairo_surface_get_device_scale(strip, &scx, &scy);
+      scale = float(1/scx);
+      width = sw;
+      height = int(std::lround(frame_height * scy));
+      num_frames = height > 0? sh / height : 0;
+      if (num_frames == 0)
+      {
+         if (argb)
+            cairo_surface_destroy(argb);
+         throw failed_to_load_pixmap{ "Filmstrip has no frames." };
+      }
+
+      auto src = cairo_image_surface_get_data(strip);
+      auto stride = cairo_image_surface_get_stride(strip);
+      uint32_t alpha = (format == CAIRO_FORMAT_RGB24)? 0xFF000000 : 0;
+
+      std::size_t n = std::size_t(width) * height;
+      std::vector<uint32_t> prev(n, 0);
+      std::vector<uint32_t> curr(n);
+      std::vector<uint32_t> delta(n);
+
+      for (std::size_t i = 0; i != num_frames; ++i)
+      {
+         for (int y = 0; y != height; ++y)
+         {
+            auto row = reinterpret_cast<uint32_t const*>(src + (i * height + y) * stride);
+            auto out = curr.data() + y * width;
+            for (int x = 0; x != width; ++x)
+               out[x] = row[x] | alpha;
+         }
+
+         if (i % key_interval == 0)
+         {
+            auto begin = words.size();
+            encode(curr.data(), n, words);
+            keys.push_back({ begin, words.size() });
+         }
+
+         for (std::size_t j = 0; j != n; ++j)
+            delta[j] = curr[j] ^ prev[j];
+         auto begin = words.size();
+         encode(delta.data(), n, words);
+         deltas.push_back({ begin, words.size() });
+
+         std::swap(prev, curr);
+      }
+      words.shrink_to_fit();
+
+      if (argb)
+         cairo_surface_destroy(argb);
+   }
+
+   compressed_filmstrip::data_ptr compressed_filmstrip::load(
+      char const* filename, float frame_height, float scale)
+   {
+      using key_type = std::tuple<std::string, float, float>;
+      static std::mutex mutex;
+      static std::map<key_type, std::weak_ptr<data const>> loaded;
+
+      auto path = find_file(filename);
+      if (path.empty())
+         throw failed_to_load_pixmap{ "File does not exist." };
+
+      auto key = key_type{ path, frame_height, scale };
+      std::lock_guard<std::mutex> lock(mutex);
+      if (auto p = loaded[key].lock())
+         return p;
+
+      // Forget the strips nobody uses anymore
+      for (auto i = loaded.begin(); i != loaded.end();)
+      {
+         if (i->second.expired() && i->first != key)
+            i = loaded.erase(i);
+         else
+            ++i;
+      }
+
+      // Decode the strip with a private pixmap that goes away as soon as
+      // it is compressed.
+      pixmap strip{ path.c_str(), scale };
+      auto p = std::make_shared<data const>(strip._surface, frame_height);
+      loaded[key] = p;
+      return p;
+   }
+
+   compressed_filmstrip::compressed_filmstrip(pixmap const& strip, float frame_height)
+    : _data(std::make_shared<data const>(strip._surface, frame_height))
+   {
+   }
+
+   compressed_filmstrip::compressed_filmstrip(
+      char const* filename, float frame_height, float scale)
+    : _data(load(filename, frame_height, scale))
+   {
+   }
+
+   compressed_filmstrip::compressed_filmstrip(compressed_filmstrip const& rhs)
+    : _data(rhs._data)
+   {
+   }
+
+   compressed_filmstrip& compressed_filmstrip::operator=(compressed_filmstrip const& rhs)
+   {
+      if (this != &rhs)
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         _data = rhs._data;
+         _pixels.clear();
+         _current = -1;
+         for (auto& c : _cache)
+            c = cached_frame{};
+      }
+      return *this;
+   }
+
+   std::size_t compressed_filmstrip::num_frames() const
+   {
+      return _data->num_frames;
+   }
+
+   extent compressed_filmstrip::frame_size() const
+   {
+      return { _data->width * _data->scale, _data->height * _data->scale };
+   }
+
+   std::size_t compressed_filmstrip::compressed_size() const
+   {
+      return _data->words.size() * sizeof(uint32_t);
+   }
+
+   compressed_filmstrip::color_key compressed_filmstrip::key_of(coloring col)
+   {
+      if (col.mode == coloring::none)
+         return {};
+      return { col.mode, premultiplied_pixel(col.color_) };
+   }
+
+   pixmap_ptr compressed_filmstrip::frame(std::size_t index, coloring col)
+   {
+      auto key = key_of(col);
+      std::lock_guard<std::mutex> lock(_mutex);
+      index = std::min(index, num_frames() - 1);
+      auto c = find(index, key);
+      if (!c)
+         c = &decode(index, col, key);
+      c->last_used = ++_tick;
+      return c->pm;
+   }
+
+   void compressed_filmstrip::prefetch(std::size_t index, coloring col)
+   {
+      // Decode the neighbours, leaving the frame itself as the most
+      // recently used. Lock per frame, so that a concurrent call to frame
+      // waits for one decode at most.
+      auto key = key_of(col);
+      auto n = num_frames();
+      for (auto i : { index + 1, index - 1 })
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         if (i < n && !find(i, key))
+            decode(i, col, key).last_used = ++_tick;
+      }
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (auto c = find(index, key))
+         c->last_used = ++_tick;
+   }
+
+   compressed_filmstrip::cached_frame*
+   compressed_filmstrip::find(std::size_t index, color_key key)
+   {
+      for (auto& c : _cache)
+         if (c.pm && c.index == index && c.key == key)
+            return &c;
+      return nullptr;
+   }
+
+   void compressed_filmstrip::seek(std::size_t index)
+   {
+      auto const& d = *_data;
+      auto const* words = d.words.data();
+      auto key = index - (index % key_interval);
+
+      // Step from the current frame if that takes no more deltas than
+      // starting over from the key frame.
+      if (_current < d.num_frames)
+      {
+         auto distance = (index > _current)? index - _current : _current - index;
+         if (distance <= index - key + 1)
+         {
+            for (; _current < index; ++_current)
+               apply_delta(words + d.deltas[_current+1].begin, words + d.deltas[_current+1].end, _pixels.data());
+            for (; _current > index; --_current)
+               apply_delta(words + d.deltas[_current].begin, words + d.deltas[_current].end, _pixels.data());
+            return;
+         }
+      }
+
+      _pixels.resize(std::size_t(d.width) * d.height);
+      auto const& k = d.keys[key / key_interval];
+      decode_key(words + k.begin, words + k.end, _pixels.data());
+      for (_current = key; _current < index; ++_current)
+         apply_delta(words + d.deltas[_current+1].begin, words + d.deltas[_current+1].end, _pixels.data());
+   }
+
+   compressed_filmstrip::cached_frame&
+   compressed_filmstrip::decode(std::size_t index, coloring col, color_key key)
+   {
+      seek(index);
+
+      // Reuse the least recently used frame. Its pixmap is reused too,
+      // unless it is still held by a caller of frame.
+      auto& c = *std::min_element(_cache.begin(), _cache.end(),
+         [](auto const& a, auto const& b) { return a.last_used < b.last_used; }
+      );
+      auto const& d = *_data;
+      if (!c.pm || c.pm.use_count() > 1)
+         c.pm = std::make_shared<pixmap>(point{ float(d.width), float(d.height) }, d.scale);
+      c.pm->clear_variants();
+      c.index = index;
+      c.key = key;
+
+      auto surface = c.pm->_surface;
+      cairo_surface_flush(surface);
+      auto dest = cairo_image_surface_get_data(surface);
+      auto stride = cairo_image_surface_get_stride(surface);
+      for (int y = 0; y != d.height; ++y)
+      {
+         auto row = _pixels.data() + y * d.width;
+         auto out = reinterpret_cast<uint32_t*>(dest + y * stride);
+         std::copy(row, row + d.width, out);
+         if (col.mode == coloring::tint)
+            tint(out, d.width, col.color_);
+         else if (col.mode == coloring::recolor)
+            recolor(out, d.width, col.color_);
+      }
+      cairo_surface_mark_dirty(surface);
+      return c;
+   }
+}}
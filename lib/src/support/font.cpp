@@ -5,6 +5,9 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <elements/support/font.hpp>
+#include <elements/support/detail/mapped_file.hpp>
+#include <elements/support/resource_bundle.hpp>
+#include <elements/support/resource_paths.hpp>
 #include <infra/assert.hpp>
 
 #include <cairo.h>
@@ -22,6 +25,7 @@
 # include FT_OUTLINE_H
 # include FT_BBOX_H
 # include FT_TYPE1_TABLES_H
+# include <fontconfig/fcfreetype.h>
 # if defined(ELEMENTS_HOST_UI_LIBRARY_WIN32)
 #  include <Windows.h>
 #  include "sysinfoapi.h"
@@ -32,7 +36,12 @@
 #endif
 
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <mutex>
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
 #include <memory>
 #include <sstream>
 #include <algorithm>
@@ -367,10 +376,11 @@ namespace cycfi { namespace elements
       struct font_entry
       {
          font_entry(FcPattern* pat, FcChar8 const* full_name, FcChar8 const* file)
-         : pattern(fc::pattern_shallow_copy_tag{}, *pat)
-         , full_name(reinterpret_cast<char const*>(full_name))
+         : full_name(reinterpret_cast<char const*>(full_name))
          , file(reinterpret_cast<char const*>(file))
          {
+            fc::pattern pattern(fc::pattern_shallow_copy_tag{}, *pat);
+
             { auto w = pattern.get_weight(); if (w)
                weight = map_fc_weight(*w); // map the weight (normalized 0 to 100)
             else
@@ -390,7 +400,6 @@ namespace cycfi { namespace elements
             }
          }
 
-         fc::pattern pattern;
          std::string full_name;
          std::string file;
          std::uint8_t weight;
@@ -399,13 +408,46 @@ namespace cycfi { namespace elements
       };
 
       using font_map_type = std::map<std::string, std::vector<font_entry>>;
-      font_map_type& font_map()
+
+      // The resolved font. The strings point to immutable storage (the
+      // font map or the mapped font index) that lives until exit.
+      struct font_match
       {
-         static font_map_type font_map_;
-         return font_map_;
+         explicit operator bool() const { return file != nullptr; }
+
+         char const* full_name = nullptr;
+         char const* file = nullptr;
+         bool        indexed = false;   // From the persistent index
+      };
+
+      // Get the best match (lower score is better) in [first, last)
+      template <typename Iter>
+      Iter best_match(font_descr descr, Iter first, Iter last)
+      {
+         int min = 10000;
+         Iter best = last;
+         for (auto j = first; j != last; ++j)
+         {
+            auto const& item = *j;
+
+            // Get biased score (lower is better). Give `slant` attribute
+            // the highest bias (3.0), followed by `weight` (1.0) and then
+            // `stretch` (0.25).
+            auto diff =
+               (std::abs(int(descr._weight) - int(item.weight)) * 1.0) +
+               (std::abs(int(descr._slant) - int(item.slant)) * 3.0) +
+               (std::abs(int(descr._stretch) - int(item.stretch)) * 0.25)
+               ;
+            if (diff < min)
+            {
+               min = diff;
+               best = j;
+            }
+         }
+         return best;
       }
 
-      void init_font_map()
+      std::vector<fs::path> app_font_dirs()
       {
          std::vector<fs::path> paths = font_paths();
 
@@ -420,6 +462,258 @@ namespace cycfi { namespace elements
          paths.push_back(fs::path(windir) / "fonts");
 #endif
 #endif
+         return paths;
+      }
+
+      std::int64_t dir_time(fs::path const& path)
+      {
+         std::error_code ec;
+         auto time = fs::last_write_time(path, ec);
+         return ec? -1 : std::int64_t(time.time_since_epoch().count());
+      }
+
+      ///////////////////////////////////////////////////////////////////////
+      // Persistent font index
+      //
+      // Scanning all the installed fonts with fontconfig is expensive. The
+      // result of the scan is saved in a binary file that is memory mapped
+      // on the next launch and searched in place. The index is valid as
+      // long as the application font directories are the same and none of
+      // the font directories changed (checked via their mtimes). These are
+      // the directories fontconfig scans, plus the directory of every
+      // indexed font file, since adding or removing a font in a
+      // subdirectory does not change the mtime of its parents.
+      //
+      // File layout (native endian):
+      //
+      //    header
+      //    dir_record[num_dirs]
+      //    entry[num_entries]      (sorted by family)
+      //    char[strings_size]      (null terminated strings)
+      ///////////////////////////////////////////////////////////////////////
+      namespace index
+      {
+         constexpr char          magic[4] = { 'E', 'F', 'I', 'X' };
+         constexpr std::uint32_t version = 2;
+
+         struct header
+         {
+            char              magic[4];
+            std::uint32_t     version;
+            std::uint32_t     num_dirs;
+            std::uint32_t     num_entries;
+            std::uint32_t     strings_size;
+            std::uint32_t     reserved;
+         };
+
+         enum { app_dir = 1 };
+
+         struct dir_record
+         {
+            std::uint32_t     path;          // string offset
+            std::uint32_t     flags;
+            std::int64_t      mtime;
+         };
+
+         struct entry
+         {
+            std::uint32_t     family;        // string offset
+            std::uint32_t     full_name;     // string offset
+            std::uint32_t     file;          // string offset
+            std::uint8_t      weight;
+            std::uint8_t      slant;
+            std::uint8_t      stretch;
+            std::uint8_t      reserved;
+         };
+
+         class font_index
+         {
+         public:
+
+            font_index(fs::path const& path)
+             : _file(path)
+            {
+               if (!_file || !validate())
+                  _file = {};
+            }
+
+            explicit operator bool() const
+            {
+               return bool(_file);
+            }
+
+            font_match find(font_descr descr, std::string const& family) const
+            {
+               auto range = std::equal_range(_entries, _entries + _header->num_entries, family,
+                  [this](auto const& a, auto const& b) { return key(a) < key(b); }
+               );
+               auto i = best_match(descr, range.first, range.second);
+               if (i == range.second)
+                  return {};
+               return { str(i->full_name), str(i->file), true };
+            }
+
+         private:
+
+            char const* str(std::uint32_t offset) const
+            {
+               return _strings + offset;
+            }
+
+            string_view key(entry const& e) const
+            {
+               return str(e.family);
+            }
+
+            string_view key(std::string const& s) const
+            {
+               return s;
+            }
+
+            bool validate()
+            {
+               if (_file.size() < sizeof(header))
+                  return false;
+
+               _header = reinterpret_cast<header const*>(_file.data());
+               if (!std::equal(magic, magic + 4, _header->magic) || _header->version != version)
+                  return false;
+
+               auto size = sizeof(header)
+                  + (std::size_t(_header->num_dirs) * sizeof(dir_record))
+                  + (std::size_t(_header->num_entries) * sizeof(entry))
+                  + _header->strings_size
+                  ;
+               if (_file.size() != size || _header->strings_size == 0)
+                  return false;
+
+               _dirs = reinterpret_cast<dir_record const*>(_header + 1);
+               _entries = reinterpret_cast<entry const*>(_dirs + _header->num_dirs);
+               _strings = reinterpret_cast<char const*>(_entries + _header->num_entries);
+               if (_strings[_header->strings_size-1] != '\0')
+                  return false;
+
+               auto valid_offset = [this](std::uint32_t offset)
+               {
+                  return offset < _header->strings_size;
+               };
+
+               for (auto i = _entries; i != _entries + _header->num_entries; ++i)
+               {
+                  if (!valid_offset(i->family) || !valid_offset(i->full_name) || !valid_offset(i->file))
+                     return false;
+               }
+
+               // All the font directories must be unchanged, and the
+               // application font directories must be the same.
+               std::vector<std::string> app_dirs;
+               for (auto i = _dirs; i != _dirs + _header->num_dirs; ++i)
+               {
+                  if (!valid_offset(i->path) || dir_time(str(i->path)) != i->mtime)
+                     return false;
+                  if (i->flags & app_dir)
+                     app_dirs.push_back(str(i->path));
+               }
+
+               std::vector<std::string> current_app_dirs;
+               for (auto const& path : app_font_dirs())
+                  current_app_dirs.push_back(path.generic_string());
+
+               std::sort(app_dirs.begin(), app_dirs.end());
+               std::sort(current_app_dirs.begin(), current_app_dirs.end());
+               return app_dirs == current_app_dirs;
+            }
+
+            detail::mapped_file  _file;
+            header const*        _header = nullptr;
+            dir_record const*    _dirs = nullptr;
+            entry const*         _entries = nullptr;
+            char const*          _strings = nullptr;
+         };
+
+         void save(
+            fs::path const& path
+          , font_map_type const& font_map_
+          , std::vector<fs::path> const& app_dirs
+          , std::vector<fs::path> const& font_dirs
+         )
+         {
+            std::string strings;
+            auto add_string = [&strings](std::string const& s)
+            {
+               auto offset = std::uint32_t(strings.size());
+               strings.append(s.c_str(), s.size() + 1);
+               return offset;
+            };
+
+            std::set<std::string> other_dirs;
+            for (auto const& dir : font_dirs)
+               other_dirs.insert(dir.generic_string());
+            for (auto const& item : font_map_)
+            {
+               for (auto const& e : item.second)
+                  other_dirs.insert(fs::path(e.file).parent_path().generic_string());
+            }
+
+            std::vector<dir_record> dirs;
+            for (auto const& dir : app_dirs)
+               dirs.push_back({ add_string(dir.generic_string()), app_dir, dir_time(dir) });
+            for (auto const& dir : other_dirs)
+               dirs.push_back({ add_string(dir), 0, dir_time(dir) });
+
+            // std::map iterates in key order, so the entries come out sorted
+            std::vector<entry> entries;
+            for (auto const& item : font_map_)
+            {
+               auto family = add_string(item.first);
+               for (auto const& e : item.second)
+               {
+                  entries.push_back({
+                     family, add_string(e.full_name), add_string(e.file)
+                   , e.weight, e.slant, e.stretch, 0
+                  });
+               }
+            }
+
+            header hdr = {
+               { magic[0], magic[1], magic[2], magic[3] }, version
+             , std::uint32_t(dirs.size()), std::uint32_t(entries.size())
+             , std::uint32_t(strings.size()), 0
+            };
+
+            // Write to a temporary file first, then move it in place, so
+            // other processes never see a partially written index.
+            std::error_code ec;
+            fs::create_directories(path.parent_path(), ec);
+            auto tmp_path = path;
+            tmp_path += ".tmp";
+            {
+               std::ofstream file(tmp_path.string(), std::ios::binary | std::ios::trunc);
+               if (!file)
+                  return;
+               file.write(reinterpret_cast<char const*>(&hdr), sizeof(hdr));
+               file.write(reinterpret_cast<char const*>(dirs.data()), dirs.size() * sizeof(dir_record));
+               file.write(reinterpret_cast<char const*>(entries.data()), entries.size() * sizeof(entry));
+               file.write(strings.data(), strings.size());
+               if (!file)
+                  return;
+            }
+            fs::rename(tmp_path, path, ec);
+            if (ec)
+               fs::remove(tmp_path, ec);
+         }
+      }
+
+      index::font_index const& font_index()
+      {
+         static index::font_index const font_index_{ font_index_path() };
+         return font_index_;
+      }
+
+      font_map_type make_font_map()
+      {
+         font_map_type font_map_;
+         std::vector<fs::path> paths = app_font_dirs();
          fc::config& conf = fc::instance();
 
          for (auto& path : paths)
@@ -441,59 +735,153 @@ namespace cycfi { namespace elements
                std::string key = reinterpret_cast<char const*>(family);
                trim(key);
 
-               font_map()[key].push_back(font_entry(font, full_name, file));
+               font_map_[key].push_back(font_entry(font, full_name, file));
             }
          }
+
+         // Save the scan for the next launch if we do not have a valid index
+         if (!font_index() && !font_index_path().empty())
+         {
+            std::vector<fs::path> font_dirs;
+            if (FcStrList* list = FcConfigGetFontDirs(conf.get()))
+            {
+               while (FcChar8* dir = FcStrListNext(list))
+                  font_dirs.push_back(reinterpret_cast<char const*>(dir));
+               FcStrListDone(list);
+            }
+            index::save(font_index_path(), font_map_, paths, font_dirs);
+         }
+         return font_map_;
       }
 
-      font_entry const* match(font_descr descr)
+      // The font map is built once, on first use, and is immutable after
+      // that. The initialization of function-local statics is thread-safe,
+      // so fonts may be matched concurrently from any thread.
+      font_map_type const& font_map()
       {
-         if (font_map().empty())
-            init_font_map();
+         static font_map_type const font_map_ = make_font_map();
+         return font_map_;
+      }
 
+      std::vector<std::string> split_families(font_descr descr)
+      {
+         std::vector<std::string> families;
          std::istringstream str(std::string{ descr._families });
          std::string family;
          while (getline(str, family, ','))
          {
             trim(family);
-            auto i = font_map().find(family);
-            if (i != font_map().end())
+            families.push_back(family);
+         }
+         return families;
+      }
+
+#ifndef __APPLE__
+      // Fonts in the mounted resource bundles are queried from memory, once,
+      // on first use, and matched before the installed fonts.
+      font_map_type make_bundle_font_map()
+      {
+         font_map_type font_map_;
+         FT_Library ft_lib;
+         if (FT_Init_FreeType(&ft_lib) != 0)
+            return font_map_;
+
+         for (auto const& path : resource_bundle_paths())
+         {
+            auto ext = fs::path(path).extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(),
+               [](char c) { return char(std::tolower(c)); });
+            if (ext != ".ttf" && ext != ".otf" && ext != ".ttc")
+               continue;
+
+            auto res = find_resource(path);
+            FT_Face face;
+            if (FT_New_Memory_Face(ft_lib, reinterpret_cast<FT_Byte const*>(res.data)
+               , FT_Long(res.size), 0, &face) != 0)
+               continue;
+
+            auto file = reinterpret_cast<FcChar8 const*>(path.c_str());
+            if (FcPattern* font = FcFreeTypeQueryFace(face, file, 0, nullptr))
             {
-               int min = 10000;
-               std::vector<font_entry>::const_iterator best_match = i->second.end();
-               for (auto j = i->second.begin(); j != i->second.end(); ++j)
+               FcChar8 *family, *full_name;
+               if (FcPatternGetString(font, FC_FAMILY, 0, &family) == FcResultMatch &&
+                  FcPatternGetString(font, FC_FULLNAME, 0, &full_name) == FcResultMatch
+               )
                {
-                  auto const& item = *j;
-
-                  // Get biased score (lower is better). Give `slant` attribute
-                  // the highest bias (3.0), followed by `weight` (1.0) and then
-                  // `stretch` (0.25).
-                  auto diff =
-                     (std::abs(int(descr._weight) - int(item.weight)) * 1.0) +
-                     (std::abs(int(descr._slant) - int(item.slant)) * 3.0) +
-                     (std::abs(int(descr._stretch) - int(item.stretch)) * 0.25)
-                     ;
-                  if (diff < min)
-                  {
-                     min = diff;
-                     best_match = j;
-                  }
+                  std::string key = reinterpret_cast<char const*>(family);
+                  trim(key);
+
+                  font_map_[key].push_back(font_entry(font, full_name, file));
                }
-               if (best_match != i->second.end())
-                  return &*best_match;
+               FcPatternDestroy(font);
+            }
+            FT_Done_Face(face);
+         }
+         FT_Done_FreeType(ft_lib);
+         return font_map_;
+      }
+
+      font_map_type const& bundle_font_map()
+      {
+         static font_map_type const font_map_ = make_bundle_font_map();
+         return font_map_;
+      }
+#endif
+
+      // Match descr against the bundled fonts, then the persistent index
+      // (unless use_index is false), then the full fontconfig scan.
+      font_match match(font_descr descr, bool use_index = true)
+      {
+         auto families = split_families(descr);
+
+#ifndef __APPLE__
+         for (auto const& family : families)
+         {
+            auto i = bundle_font_map().find(family);
+            if (i != bundle_font_map().end())
+            {
+               auto j = best_match(descr, i->second.begin(), i->second.end());
+               if (j != i->second.end())
+                  return { j->full_name.c_str(), j->file.c_str() };
             }
          }
-         return nullptr;
+#endif
+
+         // Try the persistent index first. The full fontconfig scan is
+         // done only if the index is not available or on a miss.
+         auto const& index_ = font_index();
+         if (use_index && index_)
+         {
+            for (auto const& family : families)
+            {
+               if (auto m = index_.find(descr, family))
+                  return m;
+            }
+         }
+
+         for (auto const& family : families)
+         {
+            auto i = font_map().find(family);
+            if (i != font_map().end())
+            {
+               auto j = best_match(descr, i->second.begin(), i->second.end());
+               if (j != i->second.end())
+                  return { j->full_name.c_str(), j->file.c_str() };
+            }
+         }
+         return {};
       }
 
 #ifndef __APPLE__
       class free_type_face
       {
       public:
+         using file_ptr = std::shared_ptr<detail::mapped_file>;
+
          free_type_face() = default;
 
-         free_type_face(FT_Face face)
-         : _face(face) {}
+         free_type_face(FT_Face face, file_ptr file = nullptr)
+         : _face(face), _file(std::move(file)) {}
 
          ~free_type_face()
          {
@@ -513,6 +901,7 @@ namespace cycfi { namespace elements
          free_type_face& operator=(free_type_face&& other) noexcept
          {
             std::swap(_face, other._face);
+            std::swap(_file, other._file);
             return *this;
          }
 
@@ -521,11 +910,6 @@ namespace cycfi { namespace elements
             return _face;
          }
 
-         FT_Face release()
-         {
-            return std::exchange(_face, nullptr);
-         }
-
          explicit operator bool() const
          {
             return _face != nullptr;
@@ -533,11 +917,12 @@ namespace cycfi { namespace elements
 
       private:
          FT_Face _face = nullptr;
+         file_ptr _file;   // The mapped font file (if any) backing the face
       };
 
       void destroy_free_type_face(void* face)
       {
-         FT_Done_Face(reinterpret_cast<FT_Face>(face));
+         delete static_cast<free_type_face*>(face);
       }
 
       class free_type_library
@@ -575,15 +960,38 @@ namespace cycfi { namespace elements
          friend void swap(free_type_library& lhs, free_type_library& rhs) noexcept
          {
             std::swap(lhs._ft_lib, rhs._ft_lib);
+            std::swap(lhs._files, rhs._files);
          }
 
+         // The font files are memory mapped, once per file, and shared by
+         // all the faces using them. The pages are also shared with other
+         // processes using the same fonts. If mapping fails, we let
+         // FreeType read the file instead.
          free_type_face load_face(char const* font_path)
          {
+            // Bundled fonts are already in memory, for good
+            if (auto res = find_resource(font_path))
+            {
+               FT_Face ft_face;
+               if (FT_New_Memory_Face(
+                  _ft_lib, reinterpret_cast<FT_Byte const*>(res.data)
+                , FT_Long(res.size), 0, &ft_face) == 0)
+                  return free_type_face(ft_face);
+               return free_type_face(nullptr);
+            }
+
+            auto file = map_file(font_path);
+
             FT_Face ft_face;
-            FT_Error ft_status = FT_New_Face(_ft_lib, font_path, 0, &ft_face);
+            FT_Error ft_status = file?
+               FT_New_Memory_Face(
+                  _ft_lib, reinterpret_cast<FT_Byte const*>(file->data())
+                , FT_Long(file->size()), 0, &ft_face
+               ) :
+               FT_New_Face(_ft_lib, font_path, 0, &ft_face);
 
             if (ft_status == 0)
-               return free_type_face(ft_face);
+               return free_type_face(ft_face, std::move(file));
             else
                return free_type_face(nullptr);
          }
@@ -601,30 +1009,50 @@ namespace cycfi { namespace elements
             if (cairo_face == nullptr)
                return nullptr;
 
-            // extend the freetype font face lifetime to cairo's font face lifetime
+            // extend the freetype font face (and its mapped file) lifetime
+            // to cairo's font face lifetime
             cairo_status_t cairo_status = CAIRO_STATUS_SUCCESS;
             cairo_user_data_key_t const& key = cairo_user_data_key();
-            if (cairo_font_face_get_user_data(cairo_face, &key) != ft_face.handle())
+            if (cairo_font_face_get_user_data(cairo_face, &key) == nullptr)
             {
+               std::unique_ptr<free_type_face> face_ptr{ new free_type_face(std::move(ft_face)) };
                cairo_status = cairo_font_face_set_user_data(
-                  cairo_face, &key, ft_face.handle(), &destroy_free_type_face);
-            }
+                  cairo_face, &key, face_ptr.get(), &destroy_free_type_face);
 
-            if (cairo_status == CAIRO_STATUS_SUCCESS)
-            {
-               ft_face.release();
-            }
-            else
-            {
-               cairo_font_face_destroy(cairo_face);
-               return nullptr;
+               if (cairo_status == CAIRO_STATUS_SUCCESS)
+               {
+                  face_ptr.release();
+               }
+               else
+               {
+                  cairo_font_face_destroy(cairo_face);
+                  return nullptr;
+               }
             }
 
             return cairo_face;
          }
 
       private:
+
+         free_type_face::file_ptr map_file(char const* font_path)
+         {
+            auto& file = _files[font_path];
+            if (auto p = file.lock())
+               return p;
+
+            detail::mapped_file mapped{ fs::path(font_path) };
+            if (!mapped)
+               return nullptr;
+            auto p = std::make_shared<detail::mapped_file>(std::move(mapped));
+            file = p;
+            return p;
+         }
+
+         using file_map = std::map<std::string, std::weak_ptr<detail::mapped_file>>;
+
          FT_Library _ft_lib = nullptr;
+         file_map _files;
       };
 #endif
    }
@@ -635,48 +1063,163 @@ namespace cycfi { namespace elements
       return _paths;
    }
 
-   font::font(font_descr descr)
+   namespace
+   {
+      fs::path default_font_index_path()
+      {
+         auto dir = cache_path();
+         if (dir.empty())
+            return {};
+         return dir / "font_index.bin";
+      }
+   }
+
+   fs::path& font_index_path()
    {
+      static fs::path _path = default_font_index_path();
+      return _path;
+   }
+
+   namespace
+   {
+      // Resolve the font face for descr. The returned face is owned by the
+      // cairo font map and lives until exit.
+      cairo_font_face_t* resolve(font_descr descr)
+      {
 #ifndef __APPLE__
-      static free_type_library ft_lib;
+         static free_type_library ft_lib;
 #endif
 
-      auto match_ptr = match(descr);
-      if (match_ptr)
-      {
+         auto match_ = match(descr);
+         if (!match_)
+            return nullptr;
+
          auto cairo_font_map_with_mutex = get_cairo_font_map();
          std::lock_guard<std::mutex> lock(cairo_font_map_with_mutex.second);
          cairo_font_map_type& cairo_font_map = cairo_font_map_with_mutex.first;
-         auto it = cairo_font_map.find(match_ptr->full_name);
-         if (it != cairo_font_map.end())
-         {
-            _handle = cairo_font_face_reference(it->second);
-         }
-         else
+
+         auto load = [&](font_match const& m) -> cairo_font_face_t*
          {
+            auto it = cairo_font_map.find(m.full_name);
+            if (it != cairo_font_map.end())
+               return it->second;
+
 #ifdef __APPLE__
 
             auto cfstr = CFStringCreateWithCString(
                kCFAllocatorDefault
-             , match_ptr->full_name.c_str()
+             , m.full_name
              , kCFStringEncodingUTF8
             );
             auto cgfont = CGFontCreateWithFontName(cfstr);
-            _handle = cairo_quartz_font_face_create_for_cgfont(cgfont);
+            cairo_font_face_t* face = cairo_quartz_font_face_create_for_cgfont(cgfont);
             CFRelease(cgfont);
             CFRelease(cfstr);
 #else
-            _handle = ft_lib.load_font(match_ptr->file.c_str());
+            cairo_font_face_t* face = ft_lib.load_font(m.file);
 #endif
 
-            if (_handle)
-               cairo_font_map[match_ptr->full_name] = cairo_font_face_reference(_handle);
+            if (face)
+               cairo_font_map[m.full_name] = face;
+            return face;
+         };
+
+         auto face = load(match_);
+
+         // The index may be out of date (e.g. the font file was removed or
+         // replaced). Fall back to the fontconfig scan.
+         if (!face && match_.indexed)
+         {
+            if (auto rescan = match(descr, false))
+               face = load(rescan);
          }
+         return face;
+      }
+
+      ///////////////////////////////////////////////////////////////////////
+      // Cache of resolved font descriptors. Each thread has its own cache,
+      // so it can be read without locking. The cached faces are borrowed
+      // from the cairo font map. Failed resolutions (nullptr) are cached
+      // as well.
+      ///////////////////////////////////////////////////////////////////////
+      class font_cache
+      {
+      public:
+
+         struct entry
+         {
+            std::string          families;
+            std::uint8_t         weight;
+            std::uint8_t         slant;
+            std::uint8_t         stretch;
+            cairo_font_face_t*   face;
+         };
+
+         entry const* find(font_descr descr, std::size_t hash) const
+         {
+            auto range = _map.equal_range(hash);
+            for (auto i = range.first; i != range.second; ++i)
+            {
+               auto const& e = i->second;
+               if (e.weight == descr._weight && e.slant == descr._slant &&
+                  e.stretch == descr._stretch && string_view{ e.families } == descr._families)
+                  return &e;
+            }
+            return nullptr;
+         }
+
+         void add(font_descr descr, std::size_t hash, cairo_font_face_t* face)
+         {
+            _map.emplace(hash, entry{
+               std::string{ descr._families }
+             , descr._weight, descr._slant, descr._stretch
+             , face
+            });
+         }
+
+         static std::size_t hash(font_descr descr)
+         {
+            // FNV-1a
+            std::uint64_t h = 14695981039346656037ull;
+            auto add = [&h](std::uint8_t byte)
+            {
+               h = (h ^ byte) * 1099511628211ull;
+            };
+            for (auto c : descr._families)
+               add(std::uint8_t(c));
+            add(descr._weight);
+            add(descr._slant);
+            add(descr._stretch);
+            return std::size_t(h);
+         }
+
+      private:
+
+         std::unordered_multimap<std::size_t, entry> _map;
+      };
+
+      font_cache& resolved_fonts()
+      {
+         thread_local font_cache cache;
+         return cache;
+      }
+   }
+
+   font::font(font_descr descr)
+   {
+      auto& cache = resolved_fonts();
+      auto  hash = font_cache::hash(descr);
+      cairo_font_face_t* face;
+      if (auto e = cache.find(descr, hash))
+      {
+         face = e->face;
       }
       else
       {
-         _handle = nullptr;
+         face = resolve(descr);
+         cache.add(descr, hash, face);
       }
+      _handle = face? cairo_font_face_reference(face) : nullptr;
    }
 
    font::font(font const& rhs)
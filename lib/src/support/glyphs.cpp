@@ -5,10 +5,20 @@
 =============================================================================*/
 #include <elements/support/glyphs.hpp>
 #include <elements/support/detail/scratch_context.hpp>
+#include <algorithm>
 
 namespace cycfi { namespace elements
 {
-   static detail::scratch_context scratch_context_;
+   namespace
+   {
+      // Each thread gets its own scratch context so that text can be shaped
+      // concurrently, e.g. when preparing text layouts on worker threads.
+      detail::scratch_context& scratch_context()
+      {
+         thread_local detail::scratch_context scratch_context_;
+         return scratch_context_;
+      }
+   }
 
    glyphs::glyphs(char const* first, char const* last)
     : _first(first)
@@ -33,6 +43,7 @@ namespace cycfi { namespace elements
     , _clusters(master._clusters + cluster_start)
     , _cluster_count(cluster_end - cluster_start)
     , _clusterflags(master._clusterflags)
+    , _advances(master._advances ? master._advances + glyph_start : nullptr)
    {
       CYCFI_ASSERT(_first, "Precondition failure: _first must not be null");
       CYCFI_ASSERT(_last, "Precondition failure: _last must not be null");
@@ -69,6 +80,8 @@ namespace cycfi { namespace elements
 
          _glyph_count -= glyph_index;
          _glyphs += glyph_index;
+         if (_advances)
+            _advances += glyph_index;
          _cluster_count -= clusters_skipped;
          _clusters = cluster;
          _first += clusters_skipped;
@@ -114,8 +127,11 @@ namespace cycfi { namespace elements
 
       if (_glyph_count)
       {
-         cairo_text_extents_t extents;
          auto glyph = _glyphs + _glyph_count -1;
+         if (_advances)
+            return (glyph->x + _advances[_glyph_count-1]) - _glyphs->x;
+
+         cairo_text_extents_t extents;
          cairo_scaled_font_glyph_extents(_scaled_font, glyph, 1, &extents);
          return (glyph->x + extents.x_advance) - _glyphs->x;
       }
@@ -142,9 +158,9 @@ namespace cycfi { namespace elements
    )
     : glyphs(first, last)
    {
-      canvas cnv{ *scratch_context_.context() };
+      auto cr = scratch_context().context();
+      canvas cnv{ *cr };
       cnv.font(font_, size);
-      auto cr = scratch_context_.context();
       _scaled_font = cairo_scaled_font_reference(cairo_get_scaled_font(cr));
       build(start);
    }
@@ -157,13 +173,17 @@ namespace cycfi { namespace elements
    )
     : glyphs(first, last)
    {
-      canvas cnv{ *scratch_context_.context() };
       _scaled_font = cairo_scaled_font_reference(source._scaled_font);
       build(start);
    }
 
    master_glyphs::master_glyphs(master_glyphs&& rhs)
     : glyphs(rhs._first, rhs._last)
+    , _glyph_advances(std::move(rhs._glyph_advances))
+    , _cluster_right(std::move(rhs._cluster_right))
+    , _cluster_glyph(std::move(rhs._cluster_glyph))
+    , _break_points(std::move(rhs._break_points))
+    , _line_breaks(std::move(rhs._line_breaks))
    {
       _scaled_font = rhs._scaled_font;
       _glyphs = rhs._glyphs;
@@ -171,10 +191,12 @@ namespace cycfi { namespace elements
       _clusters = rhs._clusters;
       _cluster_count = rhs._cluster_count;
       _clusterflags = rhs._clusterflags;
+      _advances = rhs._advances;
 
       rhs._glyphs = nullptr;
       rhs._clusters = nullptr;
       rhs._scaled_font = nullptr;
+      rhs._advances = nullptr;
    }
 
    master_glyphs& master_glyphs::operator=(master_glyphs&& rhs)
@@ -189,10 +211,17 @@ namespace cycfi { namespace elements
          _clusters = rhs._clusters;
          _cluster_count = rhs._cluster_count;
          _clusterflags = rhs._clusterflags;
+         _advances = rhs._advances;
+         _glyph_advances = std::move(rhs._glyph_advances);
+         _cluster_right = std::move(rhs._cluster_right);
+         _cluster_glyph = std::move(rhs._cluster_glyph);
+         _break_points = std::move(rhs._break_points);
+         _line_breaks = std::move(rhs._line_breaks);
 
          rhs._glyphs = nullptr;
          rhs._clusters = nullptr;
          rhs._scaled_font = nullptr;
+         rhs._advances = nullptr;
       }
       return *this;
    }
@@ -240,12 +269,35 @@ namespace cycfi { namespace elements
       CYCFI_ASSERT(_glyphs, "Precondition failure: _glyphs must not be null");
       CYCFI_ASSERT(_clusters, "Precondition failure: _clusters must not be null");
 
+      // Only breaking into an empty vector (the common case) is cached
+      if (!lines.empty())
+         return do_break_lines(width, lines);
+
+      auto i = std::find_if(_line_breaks.begin(), _line_breaks.end(),
+         [width](auto const& entry) { return entry.first == width; }
+      );
+
+      if (i != _line_breaks.end())
+      {
+         // Move the hit to the front (most recently used)
+         std::rotate(_line_breaks.begin(), i, i+1);
+         lines = _line_breaks.front().second;
+         return;
+      }
+
+      do_break_lines(width, lines);
+      if (_line_breaks.size() == line_break_cache_size)
+         _line_breaks.pop_back();
+      _line_breaks.emplace(_line_breaks.begin(), width, lines);
+   }
+
+   void master_glyphs::do_break_lines(float width, std::vector<glyphs>& lines)
+   {
+      int const   num_clusters = int(_cluster_right.size());
       char const* first = _first;
       char const* last = _last;
       char const* space_pos = _first;
-      int         start_glyph_index = 0;
       int         start_cluster_index = 0;
-      int         space_glyph_index = 0;
       int         space_cluster_index = 0;
       float       start_x = _glyphs->x;
 
@@ -253,59 +305,59 @@ namespace cycfi { namespace elements
       {
          glyphs glyph_{
             first, space_pos
-          , start_glyph_index, space_glyph_index
+          , _cluster_glyph[start_cluster_index], _cluster_glyph[space_cluster_index]
           , start_cluster_index, space_cluster_index
           , *this
           , lines.size() > 0 // skip leading spaces if this is not the first line
          };
          lines.push_back(std::move(glyph_));
          first = space_pos;
-         start_glyph_index = space_glyph_index;
          start_cluster_index = space_cluster_index;
-         start_x = _glyphs[space_glyph_index].x;
+         start_x = _glyphs[_cluster_glyph[space_cluster_index]].x;
       };
 
-      int      glyph_index = 0;
-      unsigned codepoint;
-      unsigned state = 0;
-
-      cairo_text_cluster_t* cluster = _clusters;
-      for (auto i = _first; i != _last; ++i)
+      auto brk = _break_points.begin();
+      int  cluster_index = 0;
+      while (cluster_index < num_clusters)
       {
-         if (!decode_utf8(state, codepoint, uint8_t(*i)))
+         // Find the first cluster that exceeds the line width
+         auto right = std::upper_bound(
+            _cluster_right.begin() + cluster_index, _cluster_right.end(), start_x + width);
+         int overflow_index = int(right - _cluster_right.begin());
+
+         // Mark the spaces before that. If we got an explicit new line, add
+         // the line right away and start searching again from there.
+         bool newline = false;
+         for (; brk != _break_points.end() && brk->cluster < overflow_index; ++brk)
          {
-            cairo_glyph_t*  glyph = _glyphs + glyph_index;
-
-            // Check if we exceeded the line width:
-            cairo_text_extents_t extents;
-            cairo_scaled_font_glyph_extents(_scaled_font, glyph, 1, &extents);
-            if (((glyph->x + extents.x_advance) - start_x) > width)
+            space_cluster_index = brk->cluster;
+            space_pos = brk->pos;
+            if ((space_cluster_index != start_cluster_index) && brk->newline)
             {
-               // Add the line if we did (exceed the line width)
                add_line();
+               cluster_index = space_cluster_index + 1;
+               newline = true;
+               ++brk;
+               break;
             }
-
-            // Did we have a space?
-            else if (is_space(codepoint))
-            {
-               // Mark the spaces for later
-               space_glyph_index = glyph_index;
-               space_cluster_index = int(cluster - _clusters);
-               space_pos = i;
-
-               // If we got an explicit new line, add the line right away.
-               if ((space_glyph_index != start_glyph_index) && is_newline(codepoint))
-                  add_line();
-            }
-
-            glyph_index += cluster->num_glyphs;
-            ++cluster;
          }
+
+         if (newline)
+            continue;
+         if (overflow_index == num_clusters)
+            break;
+
+         // Add the line if we exceeded the line width. The overflowing
+         // cluster is not a break point, even if it is a space.
+         add_line();
+         cluster_index = overflow_index + 1;
+         if (brk != _break_points.end() && brk->cluster == overflow_index)
+            ++brk;
       }
 
       glyphs glyph_{
          first, last
-       , start_glyph_index, _glyph_count
+       , _cluster_glyph[start_cluster_index], _glyph_count
        , start_cluster_index, _cluster_count
        , *this
        , lines.size() > 1 // skip leading spaces if this is not the first line
@@ -316,6 +368,13 @@ namespace cycfi { namespace elements
 
    void master_glyphs::build(point start)
    {
+      _advances = nullptr;
+      _glyph_advances.clear();
+      _cluster_right.clear();
+      _cluster_glyph.clear();
+      _break_points.clear();
+      _line_breaks.clear();
+
       // reurn early if there's nothing to build
       if (_first == _last)
          return;
@@ -331,5 +390,52 @@ namespace cycfi { namespace elements
          _clusters = nullptr;
          throw failed_to_build_master_glyphs{};
       }
+      build_metrics();
+   }
+
+   void master_glyphs::build_metrics()
+   {
+      // Compute the glyph advances once per shaping, so line breaking and
+      // measuring need not query the scaled font for each glyph again.
+      _glyph_advances.resize(_glyph_count);
+      for (int i = 0; i != _glyph_count; ++i)
+      {
+         cairo_text_extents_t extents;
+         cairo_scaled_font_glyph_extents(_scaled_font, _glyphs + i, 1, &extents);
+         _glyph_advances[i] = extents.x_advance;
+      }
+      _advances = _glyph_advances.data();
+
+      // The right edges of the clusters are prefix sums of the advances. We
+      // keep these ascending so we can binary search for line break
+      // positions. Break points (spaces) are recorded along the way.
+      _cluster_right.reserve(_cluster_count);
+      _cluster_glyph.reserve(_cluster_count + 1);
+
+      int      glyph_index = 0;
+      float    right = _glyphs->x;
+      unsigned codepoint;
+      unsigned state = 0;
+
+      cairo_text_cluster_t* cluster = _clusters;
+      cairo_text_cluster_t* clusters_end = _clusters + _cluster_count;
+      for (auto i = _first; i != _last && cluster != clusters_end; ++i)
+      {
+         if (!decode_utf8(state, codepoint, uint8_t(*i)))
+         {
+            auto cluster_index = int(cluster - _clusters);
+            if (glyph_index < _glyph_count)
+               right = std::max(right, float(_glyphs[glyph_index].x + _glyph_advances[glyph_index]));
+            _cluster_right.push_back(right);
+            _cluster_glyph.push_back(glyph_index);
+
+            if (is_space(codepoint))
+               _break_points.push_back({ cluster_index, i, is_newline(codepoint) });
+
+            glyph_index += cluster->num_glyphs;
+            ++cluster;
+         }
+      }
+      _cluster_glyph.push_back(glyph_index); // sentinel
    }
 }}
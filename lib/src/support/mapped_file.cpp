@@ -0,0 +1,99 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <elements/support/detail/mapped_file.hpp>
+#include <utility>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace cycfi { namespace elements { namespace detail
+{
+#if defined(_WIN32)
+
+   mapped_file::mapped_file(fs::path const& path)
+   {
+      HANDLE file = CreateFileW(
+         path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr
+       , OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+      );
+      if (file == INVALID_HANDLE_VALUE)
+         return;
+
+      LARGE_INTEGER size;
+      if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+      {
+         HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+         if (mapping)
+         {
+            // The view keeps the mapping alive after the handle is closed
+            if (auto p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0))
+            {
+               _data = static_cast<char const*>(p);
+               _size = std::size_t(size.QuadPart);
+            }
+            CloseHandle(mapping);
+         }
+      }
+      CloseHandle(file);
+   }
+
+   mapped_file::~mapped_file()
+   {
+      if (_data)
+         UnmapViewOfFile(_data);
+   }
+
+#else
+
+   mapped_file::mapped_file(fs::path const& path)
+   {
+      int fd = open(path.string().c_str(), O_RDONLY);
+      if (fd == -1)
+         return;
+
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+         // The mapping stays valid after the file is closed
+         void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+         if (p != MAP_FAILED)
+         {
+            _data = static_cast<char const*>(p);
+            _size = std::size_t(st.st_size);
+         }
+      }
+      close(fd);
+   }
+
+   mapped_file::~mapped_file()
+   {
+      if (_data)
+         munmap(const_cast<char*>(_data), _size);
+   }
+
+#endif
+
+   mapped_file::mapped_file(mapped_file&& rhs) noexcept
+    : _data(rhs._data)
+    , _size(rhs._size)
+   {
+      rhs._data = nullptr;
+      rhs._size = 0;
+   }
+
+   mapped_file& mapped_file::operator=(mapped_file&& rhs) noexcept
+   {
+      std::swap(_data, rhs._data);
+      std::swap(_size, rhs._size);
+      return *this;
+   }
+}}}
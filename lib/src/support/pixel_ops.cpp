@@ -0,0 +1,723 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <elements/support/pixel_ops.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The AVX2 kernels are compiled for AVX2 whether or not the rest of the
+// build targets it, and picked at runtime if the CPU supports it.
+#if defined(__AVX2__)
+# define ELEMENTS_PIXEL_OPS_AVX2
+# define ELEMENTS_TARGET_AVX2
+# include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+# define ELEMENTS_PIXEL_OPS_AVX2
+# define ELEMENTS_PIXEL_OPS_AVX2_DISPATCH
+# define ELEMENTS_TARGET_AVX2 __attribute__((target("avx2")))
+# include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+# define ELEMENTS_PIXEL_OPS_AVX2
+# define ELEMENTS_PIXEL_OPS_AVX2_DISPATCH
+# define ELEMENTS_TARGET_AVX2
+# include <immintrin.h>
+# include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define ELEMENTS_PIXEL_OPS_SSE2
+# include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define ELEMENTS_PIXEL_OPS_NEON
+# include <arm_neon.h>
+#endif
+
+namespace cycfi { namespace elements
+{
+   namespace
+   {
+      // Exact rounded x / 255, for x in [0, 255*255]. The SIMD variants
+      // below use the same formula.
+      inline uint32_t div255(uint32_t x)
+      {
+         x += 128;
+         return (x + (x >> 8)) >> 8;
+      }
+
+      inline uint32_t pack(uint32_t a, uint32_t r, uint32_t g, uint32_t b)
+      {
+         return (a << 24) | (r << 16) | (g << 8) | b;
+      }
+
+      // Unpremultiply factor. Float math so that the scalar and SIMD variants
+      // agree: products are rounded to nearest even, after clamping.
+      inline float unpremultiply_factor(uint32_t a)
+      {
+         return a? 255.0f / float(a) : 0.0f;
+      }
+
+      inline uint32_t unpremultiply_channel(uint32_t c, float f)
+      {
+         return uint32_t(std::nearbyint(std::min(float(c) * f, 255.0f)));
+      }
+
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+      inline __m128i div255_epi16(__m128i x)
+      {
+         x = _mm_add_epi16(x, _mm_set1_epi16(128));
+         return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+      }
+
+      // 16 bit R, G, B, A channels of two pixels to premultiplied B, G, R, A
+      inline __m128i premultiply_swizzle(__m128i px)
+      {
+         __m128i const keep = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+         __m128i const opaque = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+         __m128i alpha = _mm_shufflehi_epi16(
+            _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+         alpha = _mm_or_si128(_mm_and_si128(alpha, keep), opaque);
+         px = div255_epi16(_mm_mullo_epi16(px, alpha));
+         return _mm_shufflehi_epi16(
+            _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+      }
+#endif
+
+#if defined(ELEMENTS_PIXEL_OPS_NEON)
+      // Same as div255, on the product of two 8 bit values
+      inline uint8x8_t mul_div255(uint8x8_t a, uint8x8_t b)
+      {
+         uint16x8_t x = vmull_u8(a, b);
+         return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+      }
+#endif
+
+#if defined(ELEMENTS_PIXEL_OPS_AVX2)
+      bool has_avx2()
+      {
+#if !defined(ELEMENTS_PIXEL_OPS_AVX2_DISPATCH)
+         return true;
+#elif defined(_MSC_VER)
+         static bool const avx2 = []
+         {
+            // AVX2 needs CPU support, and OS support for the YMM registers
+            int info[4];
+            __cpuid(info, 1);
+            bool const osxsave = info[2] & (1 << 27);
+            bool const avx = info[2] & (1 << 28);
+            if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+               return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+         }();
+         return avx2;
+#else
+         static bool const avx2 = __builtin_cpu_supports("avx2");
+         return avx2;
+#endif
+      }
+
+      // The AVX2 kernels process the pixels eight at a time, and return
+      // the number of pixels done. The caller does the rest.
+
+      ELEMENTS_TARGET_AVX2
+      inline __m256i div255_epi16(__m256i x)
+      {
+         x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+         return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+      }
+
+      // Broadcast the 16 bit A, R, G, B channels to the four pixels of each
+      // 128 bit lane
+      ELEMENTS_TARGET_AVX2
+      inline __m256i broadcast_channels(uint32_t a, uint32_t r, uint32_t g, uint32_t b)
+      {
+         return _mm256_broadcastsi128_si256(_mm_set_epi16(
+            short(a), short(r), short(g), short(b)
+          , short(a), short(r), short(g), short(b)));
+      }
+
+      // The alpha of each pixel, in its four 16 bit channels
+      ELEMENTS_TARGET_AVX2
+      inline __m256i alpha_epi16(__m256i px)
+      {
+         return _mm256_shufflehi_epi16(
+            _mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+      }
+
+      ELEMENTS_TARGET_AVX2
+      inline __m256i premultiply_swizzle(__m256i px)
+      {
+         __m256i const keep = _mm256_broadcastsi128_si256(
+            _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1));
+         __m256i const opaque = _mm256_broadcastsi128_si256(
+            _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+         __m256i alpha = _mm256_or_si256(_mm256_and_si256(alpha_epi16(px), keep), opaque);
+         px = div255_epi16(_mm256_mullo_epi16(px, alpha));
+         return _mm256_shufflehi_epi16(
+            _mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+      }
+
+      ELEMENTS_TARGET_AVX2
+      std::size_t rgba_to_argb32_avx2(uint32_t* dest, uint8_t const* src, std::size_t n)
+      {
+         std::size_t i = 0;
+         for (__m256i const zero = _mm256_setzero_si256(); i + 8 <= n; i += 8)
+         {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i * 4));
+            __m256i lo = premultiply_swizzle(_mm256_unpacklo_epi8(px, zero));
+            __m256i hi = premultiply_swizzle(_mm256_unpackhi_epi8(px, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_packus_epi16(lo, hi));
+         }
+         return i;
+      }
+
+      // One channel of eight pixels, unpremultiplied by the factors f
+      ELEMENTS_TARGET_AVX2
+      inline __m256i unpremultiply_channel(__m256i px, int shift, __m256 f)
+      {
+         __m256i const mask = _mm256_set1_epi32(0xFF);
+         __m256 const max = _mm256_set1_ps(255.0f);
+         __m256 c = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, shift), mask));
+         return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_mul_ps(c, f), max));
+      }
+
+      ELEMENTS_TARGET_AVX2
+      std::size_t unpremultiply_avx2(uint32_t* pixels, std::size_t n)
+      {
+         __m256 const max = _mm256_set1_ps(255.0f);
+         __m256 const zero = _mm256_setzero_ps();
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+            __m256i a = _mm256_srli_epi32(px, 24);
+            __m256 af = _mm256_cvtepi32_ps(a);
+            __m256 f = _mm256_and_ps(
+               _mm256_div_ps(max, af), _mm256_cmp_ps(af, zero, _CMP_NEQ_UQ));
+
+            __m256i out = _mm256_slli_epi32(a, 24);
+            out = _mm256_or_si256(out, _mm256_slli_epi32(unpremultiply_channel(px, 16, f), 16));
+            out = _mm256_or_si256(out, _mm256_slli_epi32(unpremultiply_channel(px, 8, f), 8));
+            out = _mm256_or_si256(out, unpremultiply_channel(px, 0, f));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), out);
+         }
+         return i;
+      }
+
+      ELEMENTS_TARGET_AVX2
+      std::size_t tint_avx2(
+         uint32_t* pixels, std::size_t n
+       , uint32_t ta, uint32_t tr, uint32_t tg, uint32_t tb)
+      {
+         __m256i const zero = _mm256_setzero_si256();
+         __m256i const mult = broadcast_channels(ta, tr, tg, tb);
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+            __m256i lo = div255_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(px, zero), mult));
+            __m256i hi = div255_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(px, zero), mult));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_packus_epi16(lo, hi));
+         }
+         return i;
+      }
+
+      ELEMENTS_TARGET_AVX2
+      std::size_t recolor_avx2(
+         uint32_t* pixels, std::size_t n
+       , uint32_t ta, uint32_t tr, uint32_t tg, uint32_t tb)
+      {
+         __m256i const zero = _mm256_setzero_si256();
+         __m256i const color_ = broadcast_channels(ta, tr, tg, tb);
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            __m256i px = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+            __m256i lo = div255_epi16(_mm256_mullo_epi16(alpha_epi16(_mm256_unpacklo_epi8(px, zero)), color_));
+            __m256i hi = div255_epi16(_mm256_mullo_epi16(alpha_epi16(_mm256_unpackhi_epi8(px, zero)), color_));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_packus_epi16(lo, hi));
+         }
+         return i;
+      }
+
+      ELEMENTS_TARGET_AVX2
+      std::size_t fill_span_avx2(uint32_t* dest, std::size_t n, uint32_t src, uint32_t inv_alpha)
+      {
+         // As 16 bit channels
+         __m256i const zero = _mm256_setzero_si256();
+         __m256i const inv = _mm256_set1_epi16(short(inv_alpha));
+         __m256i const src8 = _mm256_set1_epi32(int(src));
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(dest + i));
+            __m256i lo = div255_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv));
+            __m256i hi = div255_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv));
+            d = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), src8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), d);
+         }
+         return i;
+      }
+#endif
+   }
+
+   uint32_t premultiplied_pixel(color c)
+   {
+      auto channel = [](float val)
+      {
+         return uint32_t(std::min(std::max(val, 0.0f), 1.0f) * 255 + 0.5f);
+      };
+
+      return pack(
+         channel(c.alpha)
+       , channel(c.red * c.alpha)
+       , channel(c.green * c.alpha)
+       , channel(c.blue * c.alpha)
+      );
+   }
+
+   void rgba_to_argb32(uint32_t* dest, uint8_t const* src, std::size_t n)
+   {
+      std::size_t i = 0;
+
+#if defined(ELEMENTS_PIXEL_OPS_AVX2)
+      if (has_avx2())
+         i = rgba_to_argb32_avx2(dest, src, n);
+#endif
+
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+      for (__m128i const zero = _mm_setzero_si128(); i + 4 <= n; i += 4)
+      {
+         __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 4));
+         __m128i lo = premultiply_swizzle(_mm_unpacklo_epi8(px, zero));
+         __m128i hi = premultiply_swizzle(_mm_unpackhi_epi8(px, zero));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(lo, hi));
+      }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON)
+      for (; i + 8 <= n; i += 8)
+      {
+         uint8x8x4_t px = vld4_u8(src + i * 4);   // R, G, B, A planes
+         uint8x8x4_t out;
+         out.val[0] = mul_div255(px.val[2], px.val[3]);
+         out.val[1] = mul_div255(px.val[1], px.val[3]);
+         out.val[2] = mul_div255(px.val[0], px.val[3]);
+         out.val[3] = px.val[3];
+         vst4_u8(reinterpret_cast<uint8_t*>(dest + i), out);
+      }
+#endif
+
+      for (; i != n; ++i)
+      {
+         uint8_t const* p = src + i * 4;
+         uint32_t a = p[3];
+         dest[i] = pack(a, div255(p[0] * a), div255(p[1] * a), div255(p[2] * a));
+      }
+   }
+
+   void unpremultiply(uint32_t* pixels, std::size_t n)
+   {
+      std::size_t i = 0;
+
+#if defined(ELEMENTS_PIXEL_OPS_AVX2)
+      if (has_avx2())
+         i = unpremultiply_avx2(pixels, n);
+#endif
+
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+      {
+         __m128i const mask = _mm_set1_epi32(0xFF);
+         __m128 const max = _mm_set1_ps(255.0f);
+         __m128 const zero = _mm_setzero_ps();
+         for (; i + 4 <= n; i += 4)
+         {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+            __m128i a = _mm_srli_epi32(px, 24);
+            __m128 af = _mm_cvtepi32_ps(a);
+            __m128 f = _mm_and_ps(_mm_div_ps(max, af), _mm_cmpneq_ps(af, zero));
+
+            auto channel = [&](int shift)
+            {
+               __m128 c = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, shift), mask));
+               return _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(c, f), max));
+            };
+
+            __m128i out = _mm_slli_epi32(a, 24);
+            out = _mm_or_si128(out, _mm_slli_epi32(channel(16), 16));
+            out = _mm_or_si128(out, _mm_slli_epi32(channel(8), 8));
+            out = _mm_or_si128(out, channel(0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), out);
+         }
+      }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON) && defined(__aarch64__)
+      {
+         uint32x4_t const mask = vdupq_n_u32(0xFF);
+         float32x4_t const max = vdupq_n_f32(255.0f);
+         for (; i + 4 <= n; i += 4)
+         {
+            uint32x4_t px = vld1q_u32(pixels + i);
+            uint32x4_t a = vshrq_n_u32(px, 24);
+            float32x4_t af = vcvtq_f32_u32(a);
+            uint32x4_t nonzero = vmvnq_u32(vceqq_u32(a, vdupq_n_u32(0)));
+            float32x4_t f = vreinterpretq_f32_u32(
+               vandq_u32(vreinterpretq_u32_f32(vdivq_f32(max, af)), nonzero));
+
+            auto channel = [&](uint32x4_t c)
+            {
+               return vcvtnq_u32_f32(vminq_f32(vmulq_f32(vcvtq_f32_u32(c), f), max));
+            };
+
+            uint32x4_t out = vshlq_n_u32(a, 24);
+            out = vorrq_u32(out, vshlq_n_u32(channel(vandq_u32(vshrq_n_u32(px, 16), mask)), 16));
+            out = vorrq_u32(out, vshlq_n_u32(channel(vandq_u32(vshrq_n_u32(px, 8), mask)), 8));
+            out = vorrq_u32(out, channel(vandq_u32(px, mask)));
+            vst1q_u32(pixels + i, out);
+         }
+      }
+#endif
+
+      for (; i != n; ++i)
+      {
+         uint32_t p = pixels[i];
+         uint32_t a = p >> 24;
+         float f = unpremultiply_factor(a);
+         pixels[i] = pack(
+            a
+          , unpremultiply_channel((p >> 16) & 0xFF, f)
+          , unpremultiply_channel((p >> 8) & 0xFF, f)
+          , unpremultiply_channel(p & 0xFF, f)
+         );
+      }
+   }
+
+   void tint(uint32_t* pixels, std::size_t n, color c)
+   {
+      uint32_t t = premultiplied_pixel(c);
+      uint32_t ta = t >> 24;
+      uint32_t tr = (t >> 16) & 0xFF;
+      uint32_t tg = (t >> 8) & 0xFF;
+      uint32_t tb = t & 0xFF;
+      std::size_t i = 0;
+
+#if defined(ELEMENTS_PIXEL_OPS_AVX2)
+      if (has_avx2())
+         i = tint_avx2(pixels, n, ta, tr, tg, tb);
+#endif
+
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+      {
+         __m128i const zero = _mm_setzero_si128();
+         __m128i const mult = _mm_set_epi16(
+            short(ta), short(tr), short(tg), short(tb)
+          , short(ta), short(tr), short(tg), short(tb));
+         for (; i + 4 <= n; i += 4)
+         {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+            __m128i lo = div255_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(px, zero), mult));
+            __m128i hi = div255_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(px, zero), mult));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_packus_epi16(lo, hi));
+         }
+      }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON)
+      {
+         uint8x8_t const mb = vdup_n_u8(uint8_t(tb));
+         uint8x8_t const mg = vdup_n_u8(uint8_t(tg));
+         uint8x8_t const mr = vdup_n_u8(uint8_t(tr));
+         uint8x8_t const ma = vdup_n_u8(uint8_t(ta));
+         for (; i + 8 <= n; i += 8)
+         {
+            auto p = reinterpret_cast<uint8_t*>(pixels + i);
+            uint8x8x4_t px = vld4_u8(p);          // B, G, R, A planes
+            px.val[0] = mul_div255(px.val[0], mb);
+            px.val[1] = mul_div255(px.val[1], mg);
+            px.val[2] = mul_div255(px.val[2], mr);
+            px.val[3] = mul_div255(px.val[3], ma);
+            vst4_u8(p, px);
+         }
+      }
+#endif
+
+      for (; i != n; ++i)
+      {
+         uint32_t p = pixels[i];
+         pixels[i] = pack(
+            div255((p >> 24) * ta)
+          , div255(((p >> 16) & 0xFF) * tr)
+          , div255(((p >> 8) & 0xFF) * tg)
+          , div255((p & 0xFF) * tb)
+         );
+      }
+   }
+
+   void recolor(uint32_t* pixels, std::size_t n, color c)
+   {
+      uint32_t t = premultiplied_pixel(c);
+      uint32_t ta = t >> 24;
+      uint32_t tr = (t >> 16) & 0xFF;
+      uint32_t tg = (t >> 8) & 0xFF;
+      uint32_t tb = t & 0xFF;
+      std::size_t i = 0;
+
+#if defined(ELEMENTS_PIXEL_OPS_AVX2)
+      if (has_avx2())
+         i = recolor_avx2(pixels, n, ta, tr, tg, tb);
+#endif
+
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+      {
+         __m128i const zero = _mm_setzero_si128();
+         __m128i const color_ = _mm_set_epi16(
+            short(ta), short(tr), short(tg), short(tb)
+          , short(ta), short(tr), short(tg), short(tb));
+         auto alpha = [](__m128i px)
+         {
+            return _mm_shufflehi_epi16(
+               _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+         };
+         for (; i + 4 <= n; i += 4)
+         {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+            __m128i lo = div255_epi16(_mm_mullo_epi16(alpha(_mm_unpacklo_epi8(px, zero)), color_));
+            __m128i hi = div255_epi16(_mm_mullo_epi16(alpha(_mm_unpackhi_epi8(px, zero)), color_));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_packus_epi16(lo, hi));
+         }
+      }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON)
+      {
+         uint8x8_t const mb = vdup_n_u8(uint8_t(tb));
+         uint8x8_t const mg = vdup_n_u8(uint8_t(tg));
+         uint8x8_t const mr = vdup_n_u8(uint8_t(tr));
+         uint8x8_t const ma = vdup_n_u8(uint8_t(ta));
+         for (; i + 8 <= n; i += 8)
+         {
+            auto p = reinterpret_cast<uint8_t*>(pixels + i);
+            uint8x8x4_t px = vld4_u8(p);          // B, G, R, A planes
+            uint8x8_t a = px.val[3];
+            px.val[0] = mul_div255(a, mb);
+            px.val[1] = mul_div255(a, mg);
+            px.val[2] = mul_div255(a, mr);
+            px.val[3] = mul_div255(a, ma);
+            vst4_u8(p, px);
+         }
+      }
+#endif
+
+      for (; i != n; ++i)
+      {
+         uint32_t a = pixels[i] >> 24;
+         pixels[i] = pack(
+            div255(a * ta)
+          , div255(a * tr)
+          , div255(a * tg)
+          , div255(a * tb)
+         );
+      }
+   }
+
+   namespace
+   {
+      // Scalar OVER: two channels at a time (0x00RR00BB and 0x00AA00GG)
+      inline uint32_t over(uint32_t dest, uint32_t src, uint32_t inv_alpha)
+      {
+         uint32_t rb = (dest & 0x00FF00FF) * inv_alpha + 0x00800080;
+         rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+         uint32_t ag = ((dest >> 8) & 0x00FF00FF) * inv_alpha + 0x00800080;
+         ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+         return src + (rb | ag);
+      }
+   }
+
+   void fill_span(uint32_t* dest, std::size_t n, uint32_t src)
+   {
+      uint32_t alpha = src >> 24;
+      if (alpha == 0xFF)
+      {
+         std::fill_n(dest, n, src);
+         return;
+      }
+      if (alpha == 0)
+         return;
+
+      uint32_t inv_alpha = 255 - alpha;
+      std::size_t i = 0;
+
+#if defined(ELEMENTS_PIXEL_OPS_AVX2)
+      if (has_avx2())
+         i = fill_span_avx2(dest, n, src, inv_alpha);
+#endif
+
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+      {
+         // Four pixels at a time, as 16 bit channels
+         __m128i const zero = _mm_setzero_si128();
+         __m128i const inv = _mm_set1_epi16(short(inv_alpha));
+         __m128i const src4 = _mm_set1_epi32(int(src));
+
+         for (; i + 4 <= n; i += 4)
+         {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dest + i));
+            __m128i lo = div255_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv));
+            __m128i hi = div255_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv));
+            d = _mm_add_epi8(_mm_packus_epi16(lo, hi), src4);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), d);
+         }
+      }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON)
+      {
+         uint8x8_t const inv = vdup_n_u8(uint8_t(inv_alpha));
+         uint8x8_t const sb = vdup_n_u8(uint8_t(src));
+         uint8x8_t const sg = vdup_n_u8(uint8_t(src >> 8));
+         uint8x8_t const sr = vdup_n_u8(uint8_t(src >> 16));
+         uint8x8_t const sa = vdup_n_u8(uint8_t(alpha));
+         for (; i + 8 <= n; i += 8)
+         {
+            auto p = reinterpret_cast<uint8_t*>(dest + i);
+            uint8x8x4_t px = vld4_u8(p);          // B, G, R, A planes
+            px.val[0] = vadd_u8(mul_div255(px.val[0], inv), sb);
+            px.val[1] = vadd_u8(mul_div255(px.val[1], inv), sg);
+            px.val[2] = vadd_u8(mul_div255(px.val[2], inv), sr);
+            px.val[3] = vadd_u8(mul_div255(px.val[3], inv), sa);
+            vst4_u8(p, px);
+         }
+      }
+#endif
+
+      for (; i != n; ++i)
+         dest[i] = over(dest[i], src, inv_alpha);
+   }
+
+   namespace
+   {
+      // Rounded sum / d, for the box blur's sums (at most 255 * d) with
+      // d = 2 * radius + 1 <= 255 and m = ceil(65536 / d). The SIMD variants
+      // use the same formula.
+      inline uint8_t box_average(uint32_t sum, uint32_t half, uint32_t m)
+      {
+         return uint8_t(std::min<uint32_t>(((sum + half) * m) >> 16, 255));
+      }
+
+      // Add (or subtract) a row of pixels to (from) the column sums
+      void add_row(uint16_t* sum, uint8_t const* row, int w)
+      {
+         int x = 0;
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+         for (__m128i const zero = _mm_setzero_si128(); x + 16 <= w; x += 16)
+         {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + x));
+            auto lo = reinterpret_cast<__m128i*>(sum + x);
+            auto hi = reinterpret_cast<__m128i*>(sum + x + 8);
+            _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(px, zero)));
+            _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(px, zero)));
+         }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON)
+         for (; x + 8 <= w; x += 8)
+            vst1q_u16(sum + x, vaddw_u8(vld1q_u16(sum + x), vld1_u8(row + x)));
+#endif
+         for (; x != w; ++x)
+            sum[x] += row[x];
+      }
+
+      void subtract_row(uint16_t* sum, uint8_t const* row, int w)
+      {
+         int x = 0;
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+         for (__m128i const zero = _mm_setzero_si128(); x + 16 <= w; x += 16)
+         {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + x));
+            auto lo = reinterpret_cast<__m128i*>(sum + x);
+            auto hi = reinterpret_cast<__m128i*>(sum + x + 8);
+            _mm_storeu_si128(lo, _mm_sub_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(px, zero)));
+            _mm_storeu_si128(hi, _mm_sub_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(px, zero)));
+         }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON)
+         for (; x + 8 <= w; x += 8)
+            vst1q_u16(sum + x, vsubw_u8(vld1q_u16(sum + x), vld1_u8(row + x)));
+#endif
+         for (; x != w; ++x)
+            sum[x] -= row[x];
+      }
+
+      // Store the averages of the column sums
+      void average_row(uint8_t* dest, uint16_t const* sum, int w, uint32_t half, uint32_t m)
+      {
+         int x = 0;
+#if defined(ELEMENTS_PIXEL_OPS_SSE2)
+         {
+            __m128i const half_ = _mm_set1_epi16(short(half));
+            __m128i const m_ = _mm_set1_epi16(short(m));
+            for (; x + 16 <= w; x += 16)
+            {
+               __m128i lo = _mm_loadu_si128(reinterpret_cast<__m128i const*>(sum + x));
+               __m128i hi = _mm_loadu_si128(reinterpret_cast<__m128i const*>(sum + x + 8));
+               lo = _mm_mulhi_epu16(_mm_add_epi16(lo, half_), m_);
+               hi = _mm_mulhi_epu16(_mm_add_epi16(hi, half_), m_);
+               _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), _mm_packus_epi16(lo, hi));
+            }
+         }
+#elif defined(ELEMENTS_PIXEL_OPS_NEON)
+         {
+            uint16x4_t const m_ = vdup_n_u16(uint16_t(m));
+            uint16x8_t const half_ = vdupq_n_u16(uint16_t(half));
+            for (; x + 8 <= w; x += 8)
+            {
+               uint16x8_t s = vaddq_u16(vld1q_u16(sum + x), half_);
+               uint16x8_t q = vcombine_u16(
+                  vshrn_n_u32(vmull_u16(vget_low_u16(s), m_), 16)
+                , vshrn_n_u32(vmull_u16(vget_high_u16(s), m_), 16));
+               vst1_u8(dest + x, vqmovn_u16(q));
+            }
+         }
+#endif
+         for (; x != w; ++x)
+            dest[x] = box_average(sum[x], half, m);
+      }
+   }
+
+   void box_blur(uint8_t* pixels, int w, int h, int stride, int radius)
+   {
+      radius = std::min(std::max(radius, 0), 127);
+      if (radius == 0 || w <= 0 || h <= 0)
+         return;
+
+      uint32_t const d = 2 * radius + 1;
+      uint32_t const half = d / 2;
+      uint32_t const m = (65536 + d - 1) / d;
+
+      // Horizontal pass, with a running sum per row. This one is serial.
+      std::vector<uint8_t> tmp(std::size_t(w) * h);
+      for (int y = 0; y != h; ++y)
+      {
+         uint8_t const* src = pixels + std::size_t(y) * stride;
+         uint8_t* dest = &tmp[std::size_t(y) * w];
+         uint32_t sum = 0;
+         for (int x = 0; x < radius && x < w; ++x)
+            sum += src[x];
+         for (int x = 0; x != w; ++x)
+         {
+            if (x + radius < w)
+               sum += src[x + radius];
+            dest[x] = box_average(sum, half, m);
+            if (x - radius >= 0)
+               sum -= src[x - radius];
+         }
+      }
+
+      // Vertical pass, with a running sum per column, a whole row at a
+      // time (vectorized)
+      std::vector<uint16_t> sum(w, 0);
+      for (int y = 0; y < radius && y < h; ++y)
+         add_row(sum.data(), &tmp[std::size_t(y) * w], w);
+      for (int y = 0; y != h; ++y)
+      {
+         if (y + radius < h)
+            add_row(sum.data(), &tmp[std::size_t(y + radius) * w], w);
+         average_row(pixels + std::size_t(y) * stride, sum.data(), w, half, m);
+         if (y - radius >= 0)
+            subtract_row(sum.data(), &tmp[std::size_t(y - radius) * w], w);
+      }
+   }
+}}
@@ -5,11 +5,25 @@
 =============================================================================*/
 #include <elements/support/pixmap.hpp>
 #include <elements/support/resource_paths.hpp>
+#include <elements/support/pixel_ops.hpp>
+#include <elements/support/resource_bundle.hpp>
+#include <elements/support/detail/mapped_file.hpp>
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_NO_PNG 1
 #include <elements/support/detail/stb_image.h>
 #include <infra/assert.hpp>
 #include <infra/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
 #include <string>
 
 namespace cycfi { namespace elements
@@ -25,7 +39,278 @@ namespace cycfi { namespace elements
       cairo_surface_mark_dirty(_surface);
    }
 
-   pixmap::pixmap(char const* filename, float scale)
+   namespace
+   {
+      // Convert the RGBA pixels from stb_image to a cairo surface
+      cairo_surface_t* from_rgba(uint8_t* src_data, int w, int h)
+      {
+         if (!src_data)
+            return nullptr;
+
+         auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+
+         uint8_t* dest_data = cairo_image_surface_get_data(surface);
+         size_t   src_stride = w * 4;
+         size_t   dest_stride = cairo_image_surface_get_stride(surface);
+
+         // Convert to Cairo's native endian, premultiplied ARGB32
+         for (int y = 0; y != h; ++y)
+         {
+            auto src = src_data + (y * src_stride);
+            auto dest = reinterpret_cast<uint32_t*>(dest_data + (y * dest_stride));
+            rgba_to_argb32(dest, src, w);
+         }
+
+         stbi_image_free(src_data);
+         return surface;
+      }
+
+      // Load from a bundled resource in memory
+      cairo_surface_t* load(resource res, bool png)
+      {
+         if (png)
+         {
+            struct reader
+            {
+               static cairo_status_t read(void* closure, unsigned char* data, unsigned int length)
+               {
+                  auto& r = *static_cast<resource*>(closure);
+                  if (length > r.size)
+                     return CAIRO_STATUS_READ_ERROR;
+                  std::memcpy(data, r.data, length);
+                  r.data += length;
+                  r.size -= length;
+                  return CAIRO_STATUS_SUCCESS;
+               }
+            };
+            return cairo_image_surface_create_from_png_stream(&reader::read, &res);
+         }
+
+         int w, h, components;
+         uint8_t* src_data = stbi_load_from_memory(
+            reinterpret_cast<stbi_uc const*>(res.data), int(res.size), &w, &h, &components, 4);
+         return from_rgba(src_data, w, h);
+      }
+
+      // Load from a file
+      cairo_surface_t* load(std::string const& full_path, bool png)
+      {
+         if (png)
+            return cairo_image_surface_create_from_png(full_path.c_str());
+
+         int w, h, components;
+         uint8_t* src_data = stbi_load(full_path.c_str(), &w, &h, &components, 4);
+         return from_rgba(src_data, w, h);
+      }
+
+      ///////////////////////////////////////////////////////////////////////
+      // Raster cache
+      //
+      // File layout (native endian): raster_header, then the pixels at
+      // data_offset, exactly as cairo has them in memory.
+      ///////////////////////////////////////////////////////////////////////
+      constexpr char          raster_magic[4] = { 'E', 'R', 'A', 'S' };
+      constexpr std::uint32_t raster_version = 1;
+      constexpr std::uint32_t raster_data_offset = 64;
+
+      struct raster_header
+      {
+         char              magic[4];
+         std::uint32_t     version;
+         std::uint32_t     width;
+         std::uint32_t     height;
+         std::uint32_t     stride;
+         std::uint32_t     format;
+         std::uint64_t     source_size;
+         std::uint32_t     data_offset;
+         std::uint32_t     reserved;
+      };
+
+      // The mapped raster lives as long as the surface using its pixels
+      cairo_user_data_key_t const raster_key = {};
+
+      void destroy_raster(void* file)
+      {
+         delete static_cast<detail::mapped_file*>(file);
+      }
+
+      // FNV-1a of the file's contents
+      std::uint64_t hash(detail::mapped_file const& file)
+      {
+         std::uint64_t h = 14695981039346656037ull;
+         auto p = reinterpret_cast<unsigned char const*>(file.data());
+         for (auto end = p + file.size(); p != end; ++p)
+            h = (h ^ *p) * 1099511628211ull;
+         return h;
+      }
+
+      struct raster_cache_settings
+      {
+         std::mutex           mutex;
+         fs::path             path;                      // Empty: disabled
+         std::size_t          budget = 256 * 1024 * 1024;
+      };
+
+      raster_cache_settings& get_raster_cache_settings()
+      {
+         static raster_cache_settings settings;
+         return settings;
+      }
+
+      fs::path raster_path(fs::path const& dir, detail::mapped_file const& source)
+      {
+         if (dir.empty() || !source)
+            return {};
+
+         char name[32];
+         std::snprintf(name, sizeof(name), "%016llx.raster"
+          , static_cast<unsigned long long>(hash(source)));
+         return dir / name;
+      }
+
+      cairo_surface_t* load_raster(fs::path const& path, std::size_t source_size)
+      {
+         auto file = std::make_unique<detail::mapped_file>(path);
+         if (!*file || file->size() < sizeof(raster_header))
+            return nullptr;
+
+         raster_header header;
+         std::memcpy(&header, file->data(), sizeof(header));
+         if (std::memcmp(header.magic, raster_magic, sizeof(raster_magic)) != 0
+            || header.version != raster_version
+            || header.source_size != source_size
+            || (header.format != CAIRO_FORMAT_ARGB32 && header.format != CAIRO_FORMAT_RGB24)
+            || header.stride != std::uint32_t(cairo_format_stride_for_width(
+                  cairo_format_t(header.format), int(header.width)))
+            || file->size() < header.data_offset + std::uint64_t(header.stride) * header.height)
+            return nullptr;
+
+         auto data = reinterpret_cast<unsigned char*>(
+            const_cast<char*>(file->data() + header.data_offset));
+         auto surface = cairo_image_surface_create_for_data(
+            data, cairo_format_t(header.format)
+          , int(header.width), int(header.height), int(header.stride)
+         );
+         if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS
+            || cairo_surface_set_user_data(surface, &raster_key, file.get(), &destroy_raster)
+               != CAIRO_STATUS_SUCCESS)
+         {
+            cairo_surface_destroy(surface);
+            return nullptr;
+         }
+         file.release();
+         return surface;
+      }
+
+      // A temporary file name no other thread or process uses
+      fs::path temp_path(fs::path const& path)
+      {
+         static unsigned const salt = std::random_device{}();
+         static std::atomic<unsigned> counter{ 0 };
+         auto tmp = path;
+         tmp += "." + std::to_string(salt) + "-" + std::to_string(counter++) + ".tmp";
+         return tmp;
+      }
+
+      // Keep the cache within budget by removing the least recently used
+      // rasters. Cache hits touch their raster's modification time.
+      void trim_raster_cache(fs::path const& dir, std::size_t budget)
+      {
+         struct item
+         {
+            fs::path             path;
+            fs::file_time_type   time;
+            std::uintmax_t       size;
+         };
+
+         std::vector<item> items;
+         std::uintmax_t total = 0;
+         std::error_code ec;
+         for (fs::directory_iterator i{ dir, ec }, end; !ec && i != end; i.increment(ec))
+         {
+            auto const& path = i->path();
+            if (path.extension() != ".raster")
+               continue;
+            std::error_code ec_;
+            auto size = fs::file_size(path, ec_);
+            auto time = fs::last_write_time(path, ec_);
+            if (ec_)
+               continue;
+            items.push_back({ path, time, size });
+            total += size;
+         }
+         if (total <= budget)
+            return;
+
+         std::sort(items.begin(), items.end(),
+            [](item const& a, item const& b) { return a.time < b.time; });
+         for (auto const& i : items)
+         {
+            if (total <= budget)
+               break;
+            if (fs::remove(i.path, ec))
+               total -= i.size;
+         }
+      }
+
+      void save_raster(
+         fs::path const& path, cairo_surface_t* surface
+       , std::size_t source_size, std::size_t budget)
+      {
+         auto format = cairo_image_surface_get_format(surface);
+         if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24)
+            return;
+
+         auto size = raster_data_offset + std::size_t(cairo_image_surface_get_stride(surface))
+            * cairo_image_surface_get_height(surface);
+         if (size > budget)
+            return;
+
+         cairo_surface_flush(surface);
+         raster_header header = {};
+         std::memcpy(header.magic, raster_magic, sizeof(raster_magic));
+         header.version = raster_version;
+         header.width = cairo_image_surface_get_width(surface);
+         header.height = cairo_image_surface_get_height(surface);
+         header.stride = cairo_image_surface_get_stride(surface);
+         header.format = format;
+         header.source_size = source_size;
+         header.data_offset = raster_data_offset;
+
+         // Write to a temporary file, then move it in place, so that other
+         // processes never see a partial raster.
+         std::error_code ec;
+         fs::create_directories(path.parent_path(), ec);
+         auto tmp = temp_path(path);
+         {
+            std::ofstream file(tmp.string(), std::ios::binary);
+            if (!file)
+               return;
+            char padding[raster_data_offset] = {};
+            file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            file.write(padding, raster_data_offset - sizeof(header));
+            file.write(
+               reinterpret_cast<char const*>(cairo_image_surface_get_data(surface))
+             , std::streamsize(header.stride) * header.height
+            );
+            if (!file)
+            {
+               file.close();
+               fs::remove(tmp, ec);
+               return;
+            }
+         }
+         fs::rename(tmp, path, ec);
+         if (ec)
+         {
+            fs::remove(tmp, ec);
+            return;
+         }
+         trim_raster_cache(path.parent_path(), budget);
+      }
+   }
+
+   pixmap::pixmap(char const* filename, float scale, bool raster_cache)
     : _surface(nullptr)
    {
       auto  path = std::string(filename);
@@ -37,45 +322,44 @@ namespace cycfi { namespace elements
       if (full_path == "")
          throw failed_to_load_pixmap{ "File does not exist." };
 
+      // For PNGs, use Cairo's native PNG loader. For everything else, use
+      // stb_image.
       auto  ext = path.substr(pos);
-      if (ext == ".png" || ext == ".PNG")
+      bool  png = ext == ".png" || ext == ".PNG";
+
+      if (auto res = find_resource(full_path))
       {
-         // For PNGs, use Cairo's native PNG loader
-         _surface = cairo_image_surface_create_from_png(full_path.c_str());
+         _surface = load(res, png);
       }
       else
       {
-         // For everything else, use stb_image
-         int w, h, components;
-         uint8_t* src_data = stbi_load(full_path.c_str(), &w, &h, &components, 4);
-
-         if (src_data)
+         // Use the cached raster, if we have one. If not, decode the file
+         // and cache the result for next time.
+         auto dir = raster_cache? raster_cache_path() : fs::path{};
+         detail::mapped_file source;
+         fs::path cached;
+         if (!dir.empty())
          {
-            _surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
-
-            uint8_t* dest_data = cairo_image_surface_get_data(_surface);
-            size_t   src_stride = w * 4;
-            size_t   dest_stride = cairo_image_surface_get_stride(_surface);
+            source = detail::mapped_file{ fs::path(full_path) };
+            cached = raster_path(dir, source);
+         }
 
-            for (int y = 0; y != h; ++y)
+         if (!cached.empty())
+         {
+            _surface = load_raster(cached, source.size());
+            if (_surface)
             {
-               uint8_t* src = src_data + (y * src_stride);
-               uint8_t* dest = dest_data + (y * dest_stride);
-               for (int x = 0; x != w; ++x)
-               {
-                  // $$$ TODO: Deal with endian issues $$$
-
-                  dest[0] = src[2];    // blue
-                  dest[1] = src[1];    // green
-                  dest[2] = src[0];    // red
-                  dest[3] = src[3];    // alpha
-
-                  src += 4;
-                  dest += 4;
-               }
+               // Mark it as recently used
+               std::error_code ec;
+               fs::last_write_time(cached, fs::file_time_type::clock::now(), ec);
             }
-
-            stbi_image_free(src_data);
+         }
+         if (!_surface)
+         {
+            _surface = load(full_path, png);
+            if (_surface && !cached.empty()
+               && cairo_surface_status(_surface) == CAIRO_STATUS_SUCCESS)
+               save_raster(cached, _surface, source.size(), raster_cache_budget());
          }
       }
 
@@ -89,6 +373,7 @@ namespace cycfi { namespace elements
 
    pixmap::~pixmap()
    {
+      clear_variants();
       if (_surface)
          cairo_surface_destroy(_surface);
    }
@@ -112,6 +397,476 @@ namespace cycfi { namespace elements
 
    void pixmap::scale(float val)
    {
+      clear_variants();
       cairo_surface_set_device_scale(_surface, 1/val, 1/val);
    }
+
+   namespace
+   {
+      // Rounded average of four premultiplied ARGB32 pixels, two channels
+      // at a time (0x00RR00BB and 0x00AA00GG).
+      inline uint32_t average(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+      {
+         uint32_t const mask = 0x00FF00FF;
+         uint32_t rb = (a & mask) + (b & mask) + (c & mask) + (d & mask) + 0x00020002;
+         uint32_t ag = ((a >> 8) & mask) + ((b >> 8) & mask)
+            + ((c >> 8) & mask) + ((d >> 8) & mask) + 0x00020002;
+         return ((rb >> 2) & mask) | (((ag >> 2) & mask) << 8);
+      }
+
+      // Halve the surface's size with a 2x2 box filter. Odd edges are
+      // averaged with themselves. Returns nullptr if the surface can't be
+      // halved any further. RGB24 surfaces (e.g. opaque PNGs) stay RGB24,
+      // with the unused alpha byte set to 0xFF.
+      cairo_surface_t* downscale_half(cairo_surface_t* src)
+      {
+         int sw = cairo_image_surface_get_width(src);
+         int sh = cairo_image_surface_get_height(src);
+         auto format = cairo_image_surface_get_format(src);
+         if (sw < 2 || sh < 2
+            || (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24))
+            return nullptr;
+
+         int dw = (sw + 1) / 2;
+         int dh = (sh + 1) / 2;
+         auto dest = cairo_image_surface_create(format, dw, dh);
+         if (cairo_surface_status(dest) != CAIRO_STATUS_SUCCESS)
+         {
+            cairo_surface_destroy(dest);
+            return nullptr;
+         }
+
+         cairo_surface_flush(src);
+         auto src_data = cairo_image_surface_get_data(src);
+         auto src_stride = cairo_image_surface_get_stride(src);
+         auto dest_data = cairo_image_surface_get_data(dest);
+         auto dest_stride = cairo_image_surface_get_stride(dest);
+
+         for (int y = 0; y != dh; ++y)
+         {
+            auto row0 = reinterpret_cast<uint32_t const*>(src_data + (2 * y) * src_stride);
+            auto row1 = reinterpret_cast<uint32_t const*>(
+               src_data + std::min(2 * y + 1, sh - 1) * src_stride);
+            auto out = reinterpret_cast<uint32_t*>(dest_data + y * dest_stride);
+            for (int x = 0; x != dw; ++x)
+            {
+               int x0 = 2 * x;
+               int x1 = std::min(x0 + 1, sw - 1);
+               out[x] = average(row0[x0], row0[x1], row1[x0], row1[x1]);
+            }
+            if (format == CAIRO_FORMAT_RGB24)
+            {
+               for (int x = 0; x != dw; ++x)
+                  out[x] |= 0xFF000000;
+            }
+         }
+         cairo_surface_mark_dirty(dest);
+         return dest;
+      }
+   }
+
+   namespace
+   {
+      // Guards the variants of all pixmaps
+      std::mutex& variants_mutex()
+      {
+         static std::mutex mutex;
+         return mutex;
+      }
+
+      // The largest level, up to level, at which each of src's edges (in
+      // pixels) is on a multiple of 2^level pixels, or on the pixmap's edge
+      std::size_t aligned_level(std::size_t level, rect src, extent size, float scale)
+      {
+         auto aligned = [&](float edge, float limit, std::size_t level_)
+         {
+            auto px = edge / scale;
+            auto ipx = std::lround(px);
+            if (std::abs(px - ipx) > 1e-3f)
+               return false;
+            return ipx == std::lround(limit / scale)
+               || (ipx & ((1l << level_) - 1)) == 0;
+         };
+
+         for (; level != 0; --level)
+         {
+            if (aligned(src.left, size.x, level) && aligned(src.right, size.x, level)
+               && aligned(src.top, size.y, level) && aligned(src.bottom, size.y, level))
+               break;
+         }
+         return level;
+      }
+   }
+
+   cairo_surface_t* pixmap::variant(float ratio, rect src) const
+   {
+      // ratio is the size of the drawn pixmap in device pixels relative to
+      // its actual size. Pick the smallest variant that is still at least
+      // as large as what is drawn, so we never scale up.
+      if (!_surface || !(ratio > 0) || ratio >= 0.5f)
+         return cairo_surface_reference(_surface);
+
+      auto level = aligned_level(
+         std::size_t(std::floor(-std::log2(ratio))), src, size(), scale());
+      if (level == 0)
+         return cairo_surface_reference(_surface);
+
+      std::lock_guard<std::mutex> lock(variants_mutex());
+      while (_variants.size() < level)
+      {
+         auto src_ = _variants.empty()? _surface : _variants.back();
+         auto half = downscale_half(src_);
+         if (!half)
+            break;
+
+         // Keep the same size in user coordinates as the original
+         double scx, scy;
+         cairo_surface_get_device_scale(_surface, &scx, &scy);
+         double factor = double(1u << (_variants.size() + 1));
+         cairo_surface_set_device_scale(half, scx / factor, scy / factor);
+         _variants.push_back(half);
+      }
+
+      if (_variants.empty())
+         return cairo_surface_reference(_surface);
+      return cairo_surface_reference(_variants[std::min(level, _variants.size()) - 1]);
+   }
+
+   void pixmap::make_writable()
+   {
+      // Mapped rasters are read-only. Copy the pixels before drawing into
+      // them.
+      if (!_surface || !cairo_surface_get_user_data(_surface, &raster_key))
+         return;
+
+      auto format = cairo_image_surface_get_format(_surface);
+      auto w = cairo_image_surface_get_width(_surface);
+      auto h = cairo_image_surface_get_height(_surface);
+      auto stride = cairo_image_surface_get_stride(_surface);
+      auto copy = cairo_image_surface_create(format, w, h);
+      if (cairo_surface_status(copy) != CAIRO_STATUS_SUCCESS)
+      {
+         cairo_surface_destroy(copy);
+         return;
+      }
+
+      auto src = cairo_image_surface_get_data(_surface);
+      auto dest = cairo_image_surface_get_data(copy);
+      auto dest_stride = cairo_image_surface_get_stride(copy);
+      for (int y = 0; y != h; ++y)
+         std::memcpy(dest + y * dest_stride, src + y * stride, std::min(stride, dest_stride));
+
+      double scx, scy;
+      cairo_surface_get_device_scale(_surface, &scx, &scy);
+      cairo_surface_set_device_scale(copy, scx, scy);
+      cairo_surface_mark_dirty(copy);
+      cairo_surface_destroy(_surface);
+      _surface = copy;
+   }
+
+   std::uint64_t pixmap::next_generation()
+   {
+      static std::atomic<std::uint64_t> generation{ 0 };
+      return ++generation;
+   }
+
+   void pixmap::clear_variants()
+   {
+      // The contents (or scale) are about to change
+      _generation = next_generation();
+
+      // Release the variants outside the lock: destroying the color
+      // variants clears their own variants.
+      variants variants_;
+      color_variants color_variants_;
+      {
+         std::lock_guard<std::mutex> lock(variants_mutex());
+         variants_.swap(_variants);
+         color_variants_.swap(_color_variants);
+      }
+      for (auto s : variants_)
+         cairo_surface_destroy(s);
+   }
+
+   pixmap_ptr pixmap::tinted(color c) const
+   {
+      return color_variant_of(c, false);
+   }
+
+   pixmap_ptr pixmap::recolored(color c) const
+   {
+      return color_variant_of(c, true);
+   }
+
+   namespace
+   {
+      // Each color variant is a full copy of the pixmap. Keep only the most
+      // recently used few.
+      constexpr std::size_t max_color_variants = 8;
+
+      // Find the variant and move it to the front (most recently used)
+      template <typename Variants>
+      pixmap_ptr find_color_variant(Variants& variants, std::uint32_t pixel, bool recolor_)
+      {
+         auto i = std::find_if(variants.begin(), variants.end(),
+            [&](auto const& v) { return v.pixel == pixel && v.recolor == recolor_; });
+         if (i == variants.end())
+            return {};
+         std::rotate(variants.begin(), i, i + 1);
+         return variants.front().pm;
+      }
+   }
+
+   pixmap_ptr pixmap::color_variant_of(color c, bool recolor_) const
+   {
+      auto pixel = premultiplied_pixel(c);
+      {
+         std::lock_guard<std::mutex> lock(variants_mutex());
+         if (auto pm = find_color_variant(_color_variants, pixel, recolor_))
+            return pm;
+      }
+
+      // Copy the pixels (RGB24 pixels are opaque, with an undefined alpha
+      // byte) and apply the color, a row at a time
+      cairo_surface_flush(_surface);
+      auto format = cairo_image_surface_get_format(_surface);
+      auto w = cairo_image_surface_get_width(_surface);
+      auto h = cairo_image_surface_get_height(_surface);
+      auto src = cairo_image_surface_get_data(_surface);
+      auto src_stride = cairo_image_surface_get_stride(_surface);
+      if (!src || (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24))
+         throw failed_to_load_pixmap{ "Unsupported pixmap format." };
+
+      auto pm = std::make_shared<pixmap>(point{ float(w), float(h) }, scale());
+      auto surface = pm->_surface;
+      cairo_surface_flush(surface);
+      auto dest = cairo_image_surface_get_data(surface);
+      auto dest_stride = cairo_image_surface_get_stride(surface);
+      for (int y = 0; y != h; ++y)
+      {
+         auto row = reinterpret_cast<uint32_t*>(dest + y * dest_stride);
+         std::memcpy(row, src + y * src_stride, w * sizeof(uint32_t));
+         if (format == CAIRO_FORMAT_RGB24)
+            for (int x = 0; x != w; ++x)
+               row[x] |= 0xFF000000;
+         if (recolor_)
+            recolor(row, w, c);
+         else
+            tint(row, w, c);
+      }
+      cairo_surface_mark_dirty(surface);
+
+      // Release the evicted variant outside the lock: destroying it clears
+      // its own variants.
+      pixmap_ptr evicted;
+      {
+         std::lock_guard<std::mutex> lock(variants_mutex());
+
+         // Another thread may have beaten us to it
+         if (auto found = find_color_variant(_color_variants, pixel, recolor_))
+            return found;
+
+         if (_color_variants.size() >= max_color_variants)
+         {
+            evicted = std::move(_color_variants.back().pm);
+            _color_variants.pop_back();
+         }
+         _color_variants.insert(_color_variants.begin(), { pixel, recolor_, pm });
+      }
+      return pm;
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // pixmap cache
+   ////////////////////////////////////////////////////////////////////////////
+   namespace
+   {
+      struct pixmap_cache
+      {
+         using key_type = std::pair<std::string, float>;
+         using retained_list = std::list<std::pair<key_type, pixmap_ptr>>;
+
+         struct entry
+         {
+            std::weak_ptr<pixmap>      pm;
+            std::size_t                bytes = 0;
+            retained_list::iterator    retained;
+            bool                       is_retained = false;
+         };
+
+         void                          retain(key_type const& key, entry& e, pixmap_ptr pm);
+         void                          trim();
+         void                          clear();
+
+         std::mutex                    mutex;
+         std::map<key_type, entry>     entries;
+         retained_list                 retained;      // Most recently used first
+         std::size_t                   retained_bytes = 0;
+         std::size_t                   budget = 64 * 1024 * 1024;
+      };
+
+      pixmap_cache& get_pixmap_cache()
+      {
+         static pixmap_cache cache;
+         return cache;
+      }
+
+      void pixmap_cache::retain(key_type const& key, entry& e, pixmap_ptr pm)
+      {
+         if (e.is_retained)
+         {
+            retained.splice(retained.begin(), retained, e.retained);
+         }
+         else
+         {
+            e.retained = retained.emplace(retained.begin(), key, pm);
+            e.is_retained = true;
+            retained_bytes += e.bytes;
+         }
+      }
+
+      void pixmap_cache::trim()
+      {
+         // Let go of the least recently used pixmaps until we are within
+         // budget. Those still in use elsewhere stay alive and shared.
+         while (retained_bytes > budget && !retained.empty())
+         {
+            auto& e = entries[retained.back().first];
+            e.is_retained = false;
+            retained_bytes -= e.bytes;
+            retained.pop_back();
+         }
+
+         for (auto i = entries.begin(); i != entries.end();)
+         {
+            if (!i->second.is_retained && i->second.pm.expired())
+               i = entries.erase(i);
+            else
+               ++i;
+         }
+      }
+
+      void pixmap_cache::clear()
+      {
+         auto budget_ = budget;
+         budget = 0;
+         trim();
+         budget = budget_;
+      }
+
+      std::size_t memory_size(cairo_surface_t* surface)
+      {
+         return std::size_t(cairo_image_surface_get_stride(surface))
+            * cairo_image_surface_get_height(surface);
+      }
+   }
+
+   pixmap_ptr load_pixmap(char const* filename, float scale)
+   {
+      auto& cache = get_pixmap_cache();
+      auto find = [&](std::string const& full_path) -> pixmap_ptr
+      {
+         auto i = cache.entries.find({ full_path, scale });
+         if (i != cache.entries.end())
+         {
+            if (auto pm = i->second.pm.lock())
+            {
+               cache.retain(i->first, i->second, pm);
+               return pm;
+            }
+         }
+         return {};
+      };
+
+      // Resolve the name every time: the resource_paths may change. The
+      // same file may already be loaded under another name.
+      auto full_path = find_file(filename);
+      if (full_path.empty())
+         throw failed_to_load_pixmap{ "File does not exist." };
+      {
+         std::lock_guard<std::mutex> lock(cache.mutex);
+         if (auto pm = find(full_path))
+            return pm;
+      }
+
+      // Load outside the lock
+      auto pm = std::make_shared<pixmap>(full_path.c_str(), scale);
+
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      auto key = pixmap_cache::key_type{ full_path, scale };
+      auto& e = cache.entries[key];
+      if (auto existing = e.pm.lock())
+      {
+         // Someone else loaded it while we were at it
+         cache.retain(key, e, existing);
+         return existing;
+      }
+      e.pm = pm;
+      e.bytes = memory_size(pm->_surface);
+      cache.retain(key, e, pm);
+      cache.trim();
+      return pm;
+   }
+
+   void pixmap_cache_budget(std::size_t bytes)
+   {
+      auto& cache = get_pixmap_cache();
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      cache.budget = bytes;
+      cache.trim();
+   }
+
+   std::size_t pixmap_cache_budget()
+   {
+      auto& cache = get_pixmap_cache();
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      return cache.budget;
+   }
+
+   std::size_t pixmap_cache_size()
+   {
+      auto& cache = get_pixmap_cache();
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      return cache.retained_bytes;
+   }
+
+   void clear_pixmap_cache()
+   {
+      auto& cache = get_pixmap_cache();
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      cache.clear();
+   }
+
+   void raster_cache_path(fs::path const& path)
+   {
+      auto& settings = get_raster_cache_settings();
+      std::lock_guard<std::mutex> lock(settings.mutex);
+      settings.path = path;
+   }
+
+   fs::path raster_cache_path()
+   {
+      auto& settings = get_raster_cache_settings();
+      std::lock_guard<std::mutex> lock(settings.mutex);
+      return settings.path;
+   }
+
+   void raster_cache_budget(std::size_t bytes)
+   {
+      auto& settings = get_raster_cache_settings();
+      {
+         std::lock_guard<std::mutex> lock(settings.mutex);
+         settings.budget = bytes;
+      }
+      auto dir = raster_cache_path();
+      if (!dir.empty())
+         trim_raster_cache(dir, bytes);
+   }
+
+   std::size_t raster_cache_budget()
+   {
+      auto& settings = get_raster_cache_settings();
+      std::lock_guard<std::mutex> lock(settings.mutex);
+      return settings.budget;
+   }
 }}
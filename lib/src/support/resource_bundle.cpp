@@ -0,0 +1,198 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <elements/support/resource_bundle.hpp>
+#include <elements/support/detail/mapped_file.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace cycfi { namespace elements
+{
+   namespace
+   {
+      constexpr char          magic[4] = { 'E', 'R', 'B', 'X' };
+      constexpr std::uint32_t version = 1;
+      constexpr std::size_t   header_size = 16;
+      constexpr std::size_t   entry_size = 24;
+
+      // Read little endian integers (the blob need not be aligned)
+      std::uint64_t read_le(unsigned char const* p, std::size_t bytes)
+      {
+         std::uint64_t val = 0;
+         for (std::size_t i = bytes; i != 0; --i)
+            val = (val << 8) | p[i-1];
+         return val;
+      }
+
+      class bundle
+      {
+      public:
+
+         bundle(char const* data, std::size_t size)
+          : _data(reinterpret_cast<unsigned char const*>(data))
+          , _size(size)
+         {
+         }
+
+         bool validate() const
+         {
+            if (_size < header_size
+               || std::memcmp(_data, magic, sizeof(magic)) != 0
+               || read_le(_data + 4, 4) != version)
+               return false;
+
+            auto n = num_entries();
+            if (n > (_size - header_size) / entry_size)
+               return false;
+
+            for (std::size_t i = 0; i != n; ++i)
+            {
+               auto e = entry(i);
+               if (!in_range(read_le(e, 4), read_le(e + 4, 4))
+                  || !in_range(read_le(e + 8, 8), read_le(e + 16, 8)))
+                  return false;
+            }
+            return true;
+         }
+
+         resource find(string_view name) const
+         {
+            // Binary search on the sorted entries
+            std::size_t lo = 0;
+            std::size_t hi = num_entries();
+            while (lo < hi)
+            {
+               auto mid = lo + (hi - lo) / 2;
+               auto key = name_of(mid);
+               auto cmp = key.compare(name);
+               if (cmp == 0)
+               {
+                  auto e = entry(mid);
+                  return {
+                     reinterpret_cast<char const*>(_data + read_le(e + 8, 8))
+                   , std::size_t(read_le(e + 16, 8))
+                  };
+               }
+               if (cmp < 0)
+                  lo = mid + 1;
+               else
+                  hi = mid;
+            }
+            return {};
+         }
+
+         std::size_t num_entries() const
+         {
+            return read_le(_data + 8, 4);
+         }
+
+         string_view name_of(std::size_t i) const
+         {
+            auto e = entry(i);
+            return {
+               reinterpret_cast<char const*>(_data + read_le(e, 4))
+             , std::size_t(read_le(e + 4, 4))
+            };
+         }
+
+      private:
+
+         unsigned char const* entry(std::size_t i) const
+         {
+            return _data + header_size + (i * entry_size);
+         }
+
+         bool in_range(std::uint64_t offset, std::uint64_t size) const
+         {
+            return offset <= _size && size <= _size - offset;
+         }
+
+         unsigned char const*    _data;
+         std::size_t             _size;
+      };
+
+      struct mounted_bundles
+      {
+         std::mutex                                         mutex;
+         std::vector<bundle>                                bundles;
+         std::vector<std::unique_ptr<detail::mapped_file>>  files;
+      };
+
+      mounted_bundles& get_mounted_bundles()
+      {
+         static mounted_bundles mounted;
+         return mounted;
+      }
+
+      string_view strip_prefix(string_view name)
+      {
+         auto prefix = string_view{ resource_path_prefix };
+         if (name.size() >= prefix.size() && name.substr(0, prefix.size()) == prefix)
+            return name.substr(prefix.size());
+         return name;
+      }
+   }
+
+   bool mount_resource_bundle(void const* data, std::size_t size)
+   {
+      bundle b{ static_cast<char const*>(data), size };
+      if (!b.validate())
+         return false;
+
+      auto& mounted = get_mounted_bundles();
+      std::lock_guard<std::mutex> lock(mounted.mutex);
+      mounted.bundles.push_back(b);
+      return true;
+   }
+
+   bool mount_resource_bundle(fs::path const& path)
+   {
+      auto file = std::make_unique<detail::mapped_file>(path);
+      if (!*file)
+         return false;
+
+      bundle b{ file->data(), file->size() };
+      if (!b.validate())
+         return false;
+
+      auto& mounted = get_mounted_bundles();
+      std::lock_guard<std::mutex> lock(mounted.mutex);
+      mounted.bundles.push_back(b);
+      mounted.files.push_back(std::move(file));
+      return true;
+   }
+
+   resource find_resource(string_view name)
+   {
+      name = strip_prefix(name);
+      auto& mounted = get_mounted_bundles();
+      std::lock_guard<std::mutex> lock(mounted.mutex);
+      for (auto i = mounted.bundles.rbegin(); i != mounted.bundles.rend(); ++i)
+      {
+         if (auto res = i->find(name))
+            return res;
+      }
+      return {};
+   }
+
+   std::vector<std::string> resource_bundle_paths()
+   {
+      std::vector<std::string> paths;
+      auto& mounted = get_mounted_bundles();
+      std::lock_guard<std::mutex> lock(mounted.mutex);
+      for (auto const& b : mounted.bundles)
+      {
+         for (std::size_t i = 0; i != b.num_entries(); ++i)
+         {
+            auto name = b.name_of(i);
+            paths.push_back(resource_path_prefix + std::string(name.begin(), name.end()));
+         }
+      }
+      return paths;
+   }
+}}
@@ -4,8 +4,11 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <elements/support/resource_paths.hpp>
+#include <elements/support/resource_bundle.hpp>
 #include <infra/filesystem.hpp>
 #include <infra/string_view.hpp>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
 namespace cycfi { namespace elements
@@ -14,6 +17,15 @@ namespace cycfi { namespace elements
 
    std::string find_file(string_view file)
    {
+      // Bundled resources first. These are read from memory.
+      if (find_resource(file))
+      {
+         auto name = std::string(file.begin(), file.end());
+         if (name.compare(0, std::strlen(resource_path_prefix), resource_path_prefix) == 0)
+            return name;
+         return resource_path_prefix + name;
+      }
+
       std::string full_path;
       const fs::path file_path(file.data());
       if (file_path.is_absolute())
@@ -35,4 +47,24 @@ namespace cycfi { namespace elements
       }
       return full_path;
    }
+
+   fs::path cache_path()
+   {
+      fs::path cache_dir;
+#if defined(_WIN32)
+      if (auto dir = std::getenv("LOCALAPPDATA"))
+         cache_dir = dir;
+#elif defined(__APPLE__)
+      if (auto home = std::getenv("HOME"))
+         cache_dir = fs::path(home) / "Library" / "Caches";
+#else
+      if (auto dir = std::getenv("XDG_CACHE_HOME"))
+         cache_dir = dir;
+      else if (auto home = std::getenv("HOME"))
+         cache_dir = fs::path(home) / ".cache";
+#endif
+      if (cache_dir.empty())
+         return {};
+      return cache_dir / "elements";
+   }
 }}
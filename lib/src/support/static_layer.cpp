@@ -0,0 +1,112 @@
+/*=============================================================================
+   Copyright (c) 2016-2020 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <elements/support/static_layer.hpp>
+#include <cairo.h>
+#include <cmath>
+
+namespace cycfi { namespace elements
+{
+   static_layer::static_layer(static_layer const& rhs)
+    : _surface(rhs._surface ? cairo_surface_reference(rhs._surface) : nullptr)
+    , _size(rhs._size)
+    , _margin(rhs._margin)
+    , _scale(rhs._scale)
+    , _key(rhs._key)
+   {
+   }
+
+   static_layer::~static_layer()
+   {
+      invalidate();
+   }
+
+   static_layer& static_layer::operator=(static_layer const& rhs)
+   {
+      if (this != &rhs)
+      {
+         invalidate();
+         _surface = rhs._surface ? cairo_surface_reference(rhs._surface) : nullptr;
+         _size = rhs._size;
+         _margin = rhs._margin;
+         _scale = rhs._scale;
+         _key = rhs._key;
+      }
+      return *this;
+   }
+
+   void static_layer::invalidate()
+   {
+      if (_surface)
+         cairo_surface_destroy(_surface);
+      _surface = nullptr;
+   }
+
+   bool static_layer::valid(rect bounds, float scale, layer_key const& key) const
+   {
+      return _surface
+         && _scale == scale
+         && _key == key
+         && _size.x == bounds.width()
+         && _size.y == bounds.height()
+         ;
+   }
+
+   cairo_t* static_layer::begin_update(
+      rect bounds, float margin, float scale, layer_key const& key)
+   {
+      invalidate();
+
+      auto w = int(std::ceil((bounds.width() + 2 * margin) * scale));
+      auto h = int(std::ceil((bounds.height() + 2 * margin) * scale));
+      if (w <= 0 || h <= 0)
+         return nullptr;
+
+      auto surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+      if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+      {
+         cairo_surface_destroy(surface);
+         return nullptr;
+      }
+
+      _surface = surface;
+      _size = { bounds.width(), bounds.height() };
+      _margin = margin;
+      _scale = scale;
+      _key = key;
+
+      // Draw in the same user coordinates as the client's canvas
+      auto cr = cairo_create(_surface);
+      cairo_scale(cr, scale, scale);
+      cairo_translate(cr, margin - bounds.left, margin - bounds.top);
+      return cr;
+   }
+
+   void static_layer::end_update(cairo_t* cr)
+   {
+      cairo_destroy(cr);
+      cairo_surface_flush(_surface);
+   }
+
+   void static_layer::blit(canvas& cnv, rect bounds) const
+   {
+      auto& cr = cnv.cairo_context();
+      cairo_save(&cr);
+
+      // Snap the layer's origin to device pixels so it is blitted 1:1.
+      double x = bounds.left - _margin;
+      double y = bounds.top - _margin;
+      cairo_user_to_device(&cr, &x, &y);
+      x = std::round(x);
+      y = std::round(y);
+      cairo_device_to_user(&cr, &x, &y);
+
+      cairo_translate(&cr, x, y);
+      cairo_scale(&cr, 1/_scale, 1/_scale);
+      cairo_set_source_surface(&cr, _surface, 0, 0);
+      cairo_paint(&cr);
+      cairo_restore(&cr);
+   }
+}}
@@ -5,9 +5,290 @@
 =============================================================================*/
 #include <elements/support/text_utils.hpp>
 #include <elements/support/theme.hpp>
+#include <elements/support/detail/device_scale.hpp>
+#include <cairo.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 namespace cycfi { namespace elements
 {
+   namespace
+   {
+      ////////////////////////////////////////////////////////////////////////
+      // icon_cache: Icons are rasterized once per (font, codepoint, size,
+      // scale) into alpha-mask atlas pages. Drawing an icon is then a single
+      // cairo_mask_surface in the requested color. Zooming (view::scale)
+      // produces a new scale at every step, so the number of pages is
+      // bounded: when full, the least recently used page is dropped, along
+      // with its icons.
+      ////////////////////////////////////////////////////////////////////////
+      class icon_cache
+      {
+      public:
+
+         // Icons returned by get hold a reference to their mask. Call
+         // release when done.
+         struct icon
+         {
+            void              release();
+
+            cairo_surface_t*  mask = nullptr;   // Atlas page sub-surface
+            point             offset;           // Mask origin relative to the text origin
+            point             size;             // Text extents (user units)
+            float             ascent;
+            float             descent;
+            int               page = -1;        // Id of the page holding the mask
+         };
+
+                              icon_cache() = default;
+                              icon_cache(icon_cache const&) = delete;
+                              ~icon_cache();
+         icon_cache&          operator=(icon_cache const&) = delete;
+
+         icon                 get(cairo_font_face_t* face, uint32_t code, float size, float scale);
+
+      private:
+
+         static constexpr int page_size = 512;
+         static constexpr int padding = 1;
+         static constexpr std::size_t max_pages = 8;
+
+         struct page
+         {
+            cairo_surface_t*  surface;
+            int               id;
+            std::uint64_t     last_used = 0;
+            int               x = 0;            // Current shelf position
+            int               y = 0;
+            int               shelf_height = 0;
+         };
+
+         using key = std::tuple<cairo_font_face_t*, uint32_t, float, float>;
+
+         page&                new_page(int w, int h);
+         cairo_surface_t*     allocate(int w, int h, int& x, int& y, int& id);
+         void                 touch(int id);
+         void                 evict();
+
+         std::mutex           _mutex;
+         std::map<key, icon>  _icons;
+         std::vector<page>    _pages;
+         int                  _next_id = 0;
+         std::uint64_t        _tick = 0;
+      };
+
+      void icon_cache::icon::release()
+      {
+         if (mask)
+            cairo_surface_destroy(mask);
+         mask = nullptr;
+      }
+
+      icon_cache::~icon_cache()
+      {
+         for (auto& entry : _icons)
+         {
+            if (entry.second.mask)
+               cairo_surface_destroy(entry.second.mask);
+         }
+         for (auto& p : _pages)
+            cairo_surface_destroy(p.surface);
+      }
+
+      void icon_cache::touch(int id)
+      {
+         ++_tick;
+         for (auto& p : _pages)
+         {
+            if (p.id == id)
+            {
+               p.last_used = _tick;
+               break;
+            }
+         }
+      }
+
+      // Drop the least recently used page, other than the one being filled
+      // (the last), and the icons on it. Masks handed out keep the page's
+      // surface alive until they are released.
+      void icon_cache::evict()
+      {
+         if (_pages.size() < 2)
+            return;
+         auto lru = std::min_element(_pages.begin(), _pages.end() - 1,
+            [](page const& a, page const& b) { return a.last_used < b.last_used; });
+
+         for (auto i = _icons.begin(); i != _icons.end();)
+         {
+            if (i->second.page == lru->id)
+            {
+               i->second.release();
+               i = _icons.erase(i);
+            }
+            else
+            {
+               ++i;
+            }
+         }
+         cairo_surface_destroy(lru->surface);
+         _pages.erase(lru);
+      }
+
+      icon_cache::page& icon_cache::new_page(int w, int h)
+      {
+         while (_pages.size() >= max_pages)
+            evict();
+         auto p = page{ cairo_image_surface_create(CAIRO_FORMAT_A8, w, h), _next_id++ };
+         p.last_used = ++_tick;
+         return *_pages.insert(_pages.empty()? _pages.end() : _pages.end() - 1, p);
+      }
+
+      // Shelf packing: fill the current shelf left to right, then start a
+      // new shelf below it, then a new page. Icons too large for a page get
+      // a page of their own. The page being filled is always the last one.
+      cairo_surface_t* icon_cache::allocate(int w, int h, int& x, int& y, int& id)
+      {
+         if (w > page_size || h > page_size)
+         {
+            auto& p = new_page(w, h);
+            p.y = page_size;     // Full
+            x = y = 0;
+            id = p.id;
+            return p.surface;
+         }
+
+         if (!_pages.empty())
+         {
+            auto& p = _pages.back();
+            if (p.x + w > page_size)
+            {
+               p.x = 0;
+               p.y += p.shelf_height;
+               p.shelf_height = 0;
+            }
+            if (p.y + h <= page_size)
+            {
+               x = p.x;
+               y = p.y;
+               p.x += w;
+               p.shelf_height = std::max(p.shelf_height, h);
+               p.last_used = ++_tick;
+               id = p.id;
+               return p.surface;
+            }
+         }
+
+         while (_pages.size() >= max_pages)
+            evict();
+         _pages.push_back(page{ cairo_image_surface_create(CAIRO_FORMAT_A8, page_size, page_size), _next_id++ });
+         auto& p = _pages.back();
+         x = y = 0;
+         p.x = w;
+         p.shelf_height = h;
+         p.last_used = ++_tick;
+         id = p.id;
+         return p.surface;
+      }
+
+      icon_cache::icon icon_cache::get(
+         cairo_font_face_t* face, uint32_t code, float size, float scale)
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+
+         // Return a copy, with its own reference to the mask, so that it
+         // stays valid if the page is evicted
+         auto copy = [](icon result)
+         {
+            if (result.mask)
+               cairo_surface_reference(result.mask);
+            return result;
+         };
+
+         auto i = _icons.find(key{ face, code, size, scale });
+         if (i != _icons.end())
+         {
+            touch(i->second.page);
+            return copy(i->second);
+         }
+         icon icon_;
+
+         // Measure the icon at the device size
+         auto utf8 = codepoint_to_utf8(code);
+         cairo_surface_t* scratch = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+         cairo_t* cr = cairo_create(scratch);
+         cairo_set_font_face(cr, face);
+         cairo_set_font_size(cr, size * scale);
+
+         cairo_text_extents_t extents;
+         cairo_text_extents(cr, utf8.c_str(), &extents);
+         cairo_font_extents_t font_extents;
+         cairo_font_extents(cr, &font_extents);
+         cairo_destroy(cr);
+         cairo_surface_destroy(scratch);
+
+         icon_.size = { float(extents.width / scale), float(extents.height / scale) };
+         icon_.ascent = font_extents.ascent / scale;
+         icon_.descent = font_extents.descent / scale;
+
+         // Rasterize the icon into an atlas page, with the text origin at
+         // integer pixel coordinates.
+         int left = int(std::floor(extents.x_bearing)) - padding;
+         int top = int(std::floor(extents.y_bearing)) - padding;
+         int w = int(std::ceil(extents.x_bearing + extents.width)) + padding - left;
+         int h = int(std::ceil(extents.y_bearing + extents.height)) + padding - top;
+
+         if (extents.width > 0 && extents.height > 0)
+         {
+            int x, y;
+            cairo_surface_t* surface = allocate(w, h, x, y, icon_.page);
+            cr = cairo_create(surface);
+            cairo_set_font_face(cr, face);
+            cairo_set_font_size(cr, size * scale);
+            cairo_rectangle(cr, x, y, w, h);
+            cairo_clip(cr);
+            cairo_move_to(cr, x - left, y - top);
+            cairo_show_text(cr, utf8.c_str());
+            cairo_destroy(cr);
+            cairo_surface_flush(surface);
+
+            icon_.mask = cairo_surface_create_for_rectangle(surface, x, y, w, h);
+            icon_.offset = { left / scale, top / scale };
+         }
+         else if (!_pages.empty())
+         {
+            // No mask, but evict it with the current page all the same
+            icon_.page = _pages.back().id;
+         }
+
+         _icons.emplace(key{ face, code, size, scale }, icon_);
+         return copy(icon_);
+      }
+
+      icon_cache& get_icon_cache()
+      {
+         static icon_cache cache;
+         return cache;
+      }
+
+      // Get the cached icon for the canvas' current icon font. Returns false
+      // if the canvas is rotated or skewed. In that case, the caller should
+      // draw the icon as text. Release the icon when done.
+      bool cached_icon(canvas& cnv, uint32_t code, float size, icon_cache::icon& icon_)
+      {
+         auto& cr = cnv.cairo_context();
+         auto scale = detail::device_scale(cr);
+         if (scale <= 0)
+            return false;
+         icon_ = get_icon_cache().get(cairo_get_font_face(&cr), code, size, scale);
+         return true;
+      }
+   }
+
    void draw_icon(canvas& cnv, rect bounds, uint32_t code, float size, color c)
    {
       auto  state = cnv.new_state();
@@ -15,9 +296,34 @@ namespace cycfi { namespace elements
       float cx = bounds.left + (bounds.width() / 2);
       float cy = bounds.top + (bounds.height() / 2);
       cnv.font(thm.icon_font, size);
-      cnv.fill_style(c);
-      cnv.text_align(cnv.middle | cnv.center);
-      cnv.fill_text(point{ cx, cy }, codepoint_to_utf8(code).c_str());
+
+      icon_cache::icon icon_;
+      if (!cached_icon(cnv, code, size, icon_))
+      {
+         cnv.fill_style(c);
+         cnv.text_align(cnv.middle | cnv.center);
+         cnv.fill_text(point{ cx, cy }, codepoint_to_utf8(code).c_str());
+         return;
+      }
+      if (!icon_.mask)
+         return;
+
+      // Same alignment as text_align(middle | center), with the mask snapped
+      // to device pixels so it is blitted 1:1.
+      auto& cr = cnv.cairo_context();
+      double x = cx - (icon_.size.x / 2) + icon_.offset.x;
+      double y = cy + (icon_.ascent / 2) - (icon_.descent / 2) + icon_.offset.y;
+      cairo_user_to_device(&cr, &x, &y);
+      x = std::round(x);
+      y = std::round(y);
+      cairo_device_to_user(&cr, &x, &y);
+
+      double scale = detail::device_scale(cr);
+      cairo_translate(&cr, x, y);
+      cairo_scale(&cr, 1/scale, 1/scale);
+      cairo_set_source_rgba(&cr, c.red, c.green, c.blue, c.alpha);
+      cairo_mask_surface(&cr, icon_.mask, 0, 0);
+      icon_.release();
    }
 
    void draw_icon(canvas& cnv, rect bounds, uint32_t code, float size)
@@ -30,6 +336,12 @@ namespace cycfi { namespace elements
       auto  state = cnv.new_state();
       auto& thm = get_theme();
       cnv.font(thm.icon_font, size);
+      icon_cache::icon icon_;
+      if (cached_icon(cnv, cp, size, icon_))
+      {
+         icon_.release();
+         return icon_.size;
+      }
       return cnv.measure_text(codepoint_to_utf8(cp).c_str()).size;
    }
 
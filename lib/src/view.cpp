@@ -6,6 +6,15 @@
 #include <elements/view.hpp>
 #include <elements/window.hpp>
 #include <elements/support/context.hpp>
+#include <elements/support/display_list.hpp>
+#include <elements/support/detail/device_scale.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
  namespace cycfi { namespace elements
  {
@@ -13,19 +22,27 @@
     : base_view(size_)
     , _main_element(make_scaled_content())
     , _work(_io)
-   {}
+    , _link(std::make_shared<weak_view::link>())
+   {
+      _link->view_ = this;
+   }
 
    view::view(host_view_handle h)
     : base_view(h)
     , _main_element(make_scaled_content())
     , _work(_io)
-   {}
+    , _link(std::make_shared<weak_view::link>())
+   {
+      _link->view_ = this;
+   }
 
    view::view(window& win)
     : base_view(win.host())
     , _main_element(make_scaled_content())
     , _work(_io)
+    , _link(std::make_shared<weak_view::link>())
    {
+      _link->view_ = this;
       on_change_limits = [&win](view_limits limits_)
       {
          win.limits(limits_);
@@ -35,9 +52,44 @@
 
    view::~view()
    {
+      {
+         std::lock_guard<std::mutex> lock(_link->mutex);
+         _link->view_ = nullptr;
+      }
       _io.stop();
    }
 
+   void weak_view::refresh() const
+   {
+      if (auto link_ = _link.lock())
+      {
+         std::lock_guard<std::mutex> lock(link_->mutex);
+         if (link_->view_)
+            link_->view_->refresh();   // Posted to the UI thread
+      }
+   }
+
+   void weak_view::refresh(element& e) const
+   {
+      if (auto link_ = _link.lock())
+      {
+         std::lock_guard<std::mutex> lock(link_->mutex);
+         if (auto v = link_->view_)
+         {
+            // The view's state is touched only on the UI thread
+            v->post([v, ep = &e]() { v->refresh(*ep); });
+         }
+      }
+   }
+
+   asio::thread_pool& worker_pool()
+   {
+      static asio::thread_pool pool{
+         std::max(2u, std::thread::hardware_concurrency())
+      };
+      return pool;
+   }
+
    bool view::set_limits()
    {
       if (_content.empty())
@@ -81,6 +133,9 @@
       canvas cnv{ *context_ };
       auto size_ = size();
       rect subj_bounds = { 0, 0, size_.x, size_.y };
+      _drawn_reduced = reduced_quality();
+      if (_drawn_reduced)
+         cnv.reduced_quality(true);
       context ctx{ *this, cnv, &_main_element, subj_bounds };
 
       // layout the subject only if the window bounds changes
@@ -91,7 +146,199 @@
       }
 
       // draw the subject
-      _main_element.draw(ctx);
+      if (!_tiled_drawing || !draw_tiles(*context_, subj_bounds))
+         _main_element.draw(ctx);
+   }
+
+   namespace
+   {
+      constexpr int tile_size = 256;                           // In pixels
+      constexpr int min_tiled_area = 4 * tile_size * tile_size;  // In pixels
+
+      struct tile
+      {
+                           tile() = default;
+                           tile(tile const&) = delete;
+                           ~tile();
+         tile&             operator=(tile const&) = delete;
+
+         int               x, y, width, height;    // In pixels
+         rect              bounds;                 // In view coordinates
+         cairo_surface_t*  surface = nullptr;
+      };
+
+      tile::~tile()
+      {
+         if (surface)
+            cairo_surface_destroy(surface);
+      }
+
+      void rasterize(tile& t, display_list const& list, float scale)
+      {
+         t.surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, t.width, t.height);
+         auto cr = cairo_create(t.surface);
+         cairo_translate(cr, -t.x, -t.y);
+         cairo_scale(cr, scale, scale);
+         {
+            canvas cnv{ *cr };
+            list.replay(cnv);
+         }
+         cairo_destroy(cr);
+         cairo_surface_flush(t.surface);
+      }
+
+      // The tiling work, shared with the workers. The worker pool is also
+      // used by the image loaders, so a worker may start late, even after
+      // the draw is done. It then finds no tile left and does nothing.
+      struct tile_job
+      {
+                                          tile_job(std::size_t count_, float scale_)
+                                           : tiles(count_), count(count_), scale(scale_)
+                                          {}
+
+         std::vector<tile>                tiles;
+         std::vector<display_list>        clones;
+         std::size_t const                count;
+         float const                      scale;
+         std::atomic<std::size_t>         next{ 0 };
+         std::mutex                       mutex;
+         std::condition_variable          done;
+         std::size_t                      completed = 0;
+      };
+
+      // get_list returns the recording to replay. It is called only after
+      // claiming a tile.
+      template <typename F>
+      void work(tile_job& job, F get_list)
+      {
+         for (auto ix = job.next++; ix < job.count; ix = job.next++)
+         {
+            rasterize(job.tiles[ix], get_list(), job.scale);
+            std::lock_guard<std::mutex> lock(job.mutex);
+            if (++job.completed == job.count)
+               job.done.notify_one();
+         }
+      }
+
+      // Tiles are on the device pixel grid only if the target's origin is
+      bool is_pixel_aligned(cairo_t& cr)
+      {
+         cairo_matrix_t mat;
+         cairo_get_matrix(&cr, &mat);
+         auto target = cairo_get_group_target(&cr);
+         double sx, sy, ox, oy;
+         cairo_surface_get_device_scale(target, &sx, &sy);
+         cairo_surface_get_device_offset(target, &ox, &oy);
+
+         auto integral = [](double val)
+         {
+            return std::abs(val - std::round(val)) < 1e-3;
+         };
+         return integral((mat.x0 * sx) + ox) && integral((mat.y0 * sy) + oy);
+      }
+   }
+
+   // Draw the dirty region in tiles. The element tree is not thread safe,
+   // so it is drawn once, here, into a display list recorded at the device
+   // scale. The recording is then replayed into each tile, in parallel,
+   // each into its own image surface with its own cairo_t, and the tiles
+   // are composited into the target. Replaying one recording from several
+   // threads is not safe in cairo, so each worker replays its own clone.
+   // Returns false if the dirty region is too small to benefit, or the
+   // target is rotated, skewed or not aligned to device pixels.
+   bool view::draw_tiles(cairo_t& context_, rect subj_bounds)
+   {
+      auto scale = detail::device_scale(context_);
+      if (scale <= 0 || !is_pixel_aligned(context_))
+         return false;
+
+      int left = std::floor(_dirty.left * scale);
+      int top = std::floor(_dirty.top * scale);
+      int right = std::ceil(_dirty.right * scale);
+      int bottom = std::ceil(_dirty.bottom * scale);
+      if ((right - left) * (bottom - top) < min_tiled_area)
+         return false;
+
+      // Record the dirty region once
+      display_list list;
+      list.record(
+         [&](canvas& cnv)
+         {
+            if (_drawn_reduced)
+               cnv.reduced_quality(true);
+            context ctx{ *this, cnv, &_main_element, subj_bounds };
+            _main_element.draw(ctx);
+         }
+       , scale
+      );
+
+      auto job = std::make_shared<tile_job>(
+         ((right - left + tile_size - 1) / tile_size)
+       * ((bottom - top + tile_size - 1) / tile_size)
+       , scale
+      );
+      auto& tiles = job->tiles;
+      auto i = tiles.begin();
+      for (int y = top; y < bottom; y += tile_size)
+      {
+         for (int x = left; x < right; x += tile_size, ++i)
+         {
+            i->x = x;
+            i->y = y;
+            i->width = std::min(tile_size, right - x);
+            i->height = std::min(tile_size, bottom - y);
+            i->bounds = {
+               x / scale, y / scale
+             , (x + i->width) / scale, (y + i->height) / scale
+            };
+         }
+      }
+
+      // Rasterize in parallel, with this thread taking its share. Wait
+      // for the tiles, not for the workers: some may not have started yet.
+      std::size_t workers = std::min<std::size_t>(
+         job->count - 1, std::thread::hardware_concurrency());
+
+      // Clones are made and destroyed here: they are linked to the
+      // original as snapshots. A worker only touches its clone after
+      // claiming a tile, so none is in use once all tiles are done.
+      job->clones.reserve(workers);
+      for (std::size_t w = 0; w != workers; ++w)
+         job->clones.push_back(list.clone());
+
+      for (std::size_t w = 0; w != workers; ++w)
+      {
+         asio::post(worker_pool(),
+            [job, w]()
+            {
+               work(*job,
+                  [&]() -> display_list const& { return job->clones[w]; });
+            }
+         );
+      }
+      work(*job, [&]() -> display_list const& { return list; });
+      {
+         std::unique_lock<std::mutex> lock(job->mutex);
+         job->done.wait(lock, [&job]{ return job->completed == job->count; });
+      }
+
+      // Composite the tiles
+      for (auto& t : tiles)
+      {
+         cairo_save(&context_);
+         cairo_translate(&context_, t.bounds.left, t.bounds.top);
+         cairo_scale(&context_, 1/scale, 1/scale);
+         cairo_set_source_surface(&context_, t.surface, 0, 0);
+         cairo_new_path(&context_);
+         cairo_rectangle(&context_, 0, 0, t.width, t.height);
+         cairo_fill(&context_);
+         cairo_restore(&context_);
+      }
+
+      // Release the clones and the tiles here, not in a late worker
+      job->clones.clear();
+      tiles.clear();
+      return true;
    }
 
    namespace
@@ -336,6 +583,17 @@
       refresh();
    }
 
+   void view::begin_live_resize()
+   {
+      _live_resizing = true;
+   }
+
+   void view::end_live_resize()
+   {
+      _live_resizing = false;
+      restore_quality();
+   }
+
    void view::poll()
    {
       _io.poll();
@@ -351,6 +609,35 @@
             _tracking_state = tracking::none;
          }
       }
+
+      // Wheel scrolls and drags have no explicit end, so quality is also
+      // restored when they pause
+      restore_quality();
+   }
+
+   namespace
+   {
+      constexpr auto quality_settle_time = std::chrono::milliseconds(150);
+   }
+
+   bool view::reduced_quality() const
+   {
+      if (!_reduce_quality_while_tracking)
+         return false;
+      if (_live_resizing)
+         return true;
+      return _tracking_state == tracking::while_tracking
+         && (std::chrono::steady_clock::now() - _tracking_time) < quality_settle_time;
+   }
+
+   // Redraw at full quality if the last frame was drawn at reduced quality
+   void view::restore_quality()
+   {
+      if (_drawn_reduced && !reduced_quality())
+      {
+         _drawn_reduced = false;
+         refresh();
+      }
    }
 
    void view::manage_on_tracking(element& e, tracking state)
@@ -367,5 +654,7 @@
       _tracking_state = state;
       _tracking_time = std::chrono::steady_clock::now();
       on_tracking(e, state);
+      if (state == tracking::end_tracking)
+         restore_quality();
    }
 }}